@@ -0,0 +1,248 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include "AbcdSpaceContinuousDistribution.h"
+
+// order in which ba (1), ca (2) and da (3) are incremented along the
+// edges of each of the 6 simplices of a lattice cube
+static const int Perms[6][3] = {{1,2,3}, {1,3,2}, {2,1,3}, {2,3,1}, {3,1,2}, {3,2,1}};
+
+AbcdSpaceContinuousDistribution::AbcdSpaceContinuousDistribution(const ObservedHotspots &observedHotspots, const AbcdSpaceLimitsInt &limits,
+																 int inOrder) {
+	LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*CellRes;
+	ObservationCollector collector;
+	collector.observations = &observations;
+	observedHotspots.Visit(collector);
+
+	// the likelihood on a cell is a polynomial of degree (# observations),
+	// and one more for the moments, so order 0 selects an exact rule
+	order = inOrder;
+	if (order <= 0)
+		order = (observations.size() + 5)/2;
+
+	CalculateQuadratureNodes();
+	FindCells(limits);
+	ComputeMoments();
+}
+
+long int AbcdSpaceContinuousDistribution::GetNumCells() {
+	return cells.size();
+}
+
+long int AbcdSpaceContinuousDistribution::GetNumCandidateCells() {
+	return numCandidateCells;
+}
+
+int AbcdSpaceContinuousDistribution::GetOrder() {
+	return order;
+}
+
+Double AbcdSpaceContinuousDistribution::CalculateHotspotProbability(const HotspotCoords coord, Double prob) {
+	if (coord.moonLat == HotspotCoords::MissingCoord ||
+		coord.moonLong == HotspotCoords::MissingCoord ||
+		coord.marsLat == HotspotCoords::MissingCoord ||
+		coord.marsLong == HotspotCoords::MissingCoord) {
+		printf("Error: Coordinates are missing: (%d, %d, %d, %d)\n",
+			   coord.moonLat, coord.moonLong, coord.marsLat, coord.marsLong);
+		exit(EXIT_FAILURE);
+	}
+
+	for (std::vector<AbcdSpaceCell>::iterator cell = cells.begin(); cell < cells.end(); cell++) {
+		Double values[4];
+		if (CalculateFactor(coord, *cell, values)) {
+			for (int j = 0; j < 4; j++)
+				prob += values[j]*cell->moments[j];
+		}
+	}
+
+	return prob;
+}
+
+void AbcdSpaceContinuousDistribution::CalculateQuadratureNodes() {
+	// Gauss-Legendre nodes & weights on [0,1]
+	std::vector<Double> x, w;
+	for (int i = 0; i < order; i++) {
+		Double z = cos(M_PI*(i + 0.75)/(order + 0.5));
+		Double dp = 1;
+		for (int iter = 0; iter < 100; iter++) {
+			Double p0 = 1;
+			Double p1 = z;
+			for (int k = 2; k <= order; k++) {
+				Double p2 = ((2*k - 1)*z*p1 - (k - 1)*p0)/k;
+				p0 = p1;
+				p1 = p2;
+			}
+			dp = order*(z*p1 - p0)/(z*z - 1);
+			Double dz = p1/dp;
+			z -= dz;
+			if (fabsl(dz) < 1e-18)
+				break;
+		}
+		x.push_back((1 - z)/2);
+		w.push_back(1/((1 - z*z)*dp*dp));
+	}
+
+	// collapse the unit cube onto the unit simplex
+	for (int i = 0; i < order; i++) {
+		for (int j = 0; j < order; j++) {
+			for (int k = 0; k < order; k++) {
+				Double s = x[i];
+				Double t = x[j];
+				Double u = x[k];
+				nodeLambdas.push_back((1 - s)*(1 - t)*(1 - u));
+				nodeLambdas.push_back(s);
+				nodeLambdas.push_back((1 - s)*t);
+				nodeLambdas.push_back((1 - s)*(1 - t)*u);
+				nodeWeights.push_back(w[i]*w[j]*w[k]*(1 - s)*(1 - s)*(1 - t));
+			}
+		}
+	}
+}
+
+void AbcdSpaceContinuousDistribution::FindCells(const AbcdSpaceLimitsInt &limsInt) {
+	for (int ba = LimitCount - limsInt.limits[0][1]; ba < limsInt.limits[1][0]; ba++) {
+		for (int ca = LimitCount - limsInt.limits[0][2]; ca < limsInt.limits[2][0]; ca++) {
+			for (int da = LimitCount - limsInt.limits[0][3]; da < limsInt.limits[3][0]; da++) {
+				for (int perm = 0; perm < 6; perm++) {
+					// centroid of the simplex, in quarter units
+					int x[4] = {0, 4*ba, 4*ca, 4*da};
+					for (int p = 0; p < 3; p++)
+						x[Perms[perm][p]] += 3 - p;
+
+					if (x[2]-x[1] > 4*(LimitCount - limsInt.limits[1][2]) && x[2]-x[1] < 4*limsInt.limits[2][1] &&
+						x[3]-x[1] > 4*(LimitCount - limsInt.limits[1][3]) && x[3]-x[1] < 4*limsInt.limits[3][1] &&
+						x[3]-x[2] > 4*(LimitCount - limsInt.limits[2][3]) && x[3]-x[2] < 4*limsInt.limits[3][2]) {
+
+						AbcdSpaceCell cell;
+						cell.ba = ba;
+						cell.ca = ca;
+						cell.da = da;
+						cell.perm = perm;
+						cells.push_back(cell);
+					}
+				}
+			}
+		}
+	}
+}
+
+void AbcdSpaceContinuousDistribution::ComputeMoments() {
+	static const Double ScaleFactor = 3.2*HotspotCoords::NumLongs;
+
+	int numObservations = observations.size();
+	long int numCells = cells.size();
+	numCandidateCells = numCells;
+	long int numNodes = nodeWeights.size();
+
+	#ifdef using_parallel
+	#pragma omp parallel
+	#endif
+	{
+		std::vector<Double> factors(4*numObservations);
+
+		#ifdef using_parallel
+		#pragma omp for schedule(dynamic, 64)
+		#endif
+		for (long int i = 0; i < numCells; i++) {
+			AbcdSpaceCell &cell = cells[i];
+			for (int j = 0; j < 4; j++)
+				cell.moments[j] = 0;
+
+			// factors that are constant on the cell are pulled out of the integral
+			Double constant = 1;
+			int numVarying = 0;
+			bool isZero = false;
+			for (int k = 0; k < numObservations && !isZero; k++) {
+				Double* values = &factors[4*numVarying];
+				isZero = !CalculateFactor(observations[k], cell, values);
+				for (int j = 0; j < 4; j++)
+					values[j] *= ScaleFactor/LimitCount;
+				if (values[0] == values[1] && values[1] == values[2] && values[2] == values[3])
+					constant *= values[0];
+				else
+					numVarying++;
+			}
+			if (isZero)
+				continue;
+
+			for (long int n = 0; n < numNodes; n++) {
+				const Double* lambda = &nodeLambdas[4*n];
+				Double value = nodeWeights[n]*constant;
+				for (int k = 0; k < numVarying; k++) {
+					const Double* f = &factors[4*k];
+					value *= f[0]*lambda[0] + f[1]*lambda[1] + f[2]*lambda[2] + f[3]*lambda[3];
+				}
+				for (int j = 0; j < 4; j++)
+					cell.moments[j] += value*lambda[j];
+			}
+		}
+	}
+
+	int offset = 0;
+	for (long int i = 0; i < numCells; i++) {
+		if (cells[i].moments[0] + cells[i].moments[1] + cells[i].moments[2] + cells[i].moments[3] > 0) {
+			cells[i-offset] = cells[i];
+		} else {
+			offset++;
+		}
+	}
+	cells.resize(numCells - offset);
+}
+
+bool AbcdSpaceContinuousDistribution::CalculateFactor(const HotspotCoords &coord, const AbcdSpaceCell &cell, Double values[4]) {
+	int latScale = LimitCount/HotspotCoords::NumLats;
+	int longScale = LimitCount/HotspotCoords::NumLongs;
+	int quarterCount = 4*LimitCount;
+
+	const Coord coords[4] = {coord.moonLat, coord.moonLong, coord.marsLat, coord.marsLong};
+	const int scales[4] = {latScale, longScale, latScale, longScale};
+
+	// position of each coordinate within the cube, in quarter units, at
+	// the centroid of the simplex, and the vertex at which it steps up
+	int base[4] = {0, cell.ba, cell.ca, cell.da};
+	int frac[4] = {0, 0, 0, 0};
+	int step[4] = {4, 0, 0, 0};
+	for (int p = 0; p < 3; p++) {
+		frac[Perms[cell.perm][p]] = 3 - p;
+		step[Perms[cell.perm][p]] = p + 1;
+	}
+
+	int a = coord.moonLat*latScale;
+	int xmin = -4*(latScale/2);
+	int xmax = 4*(latScale - latScale/2);
+	int lowIndex = 0;
+	int highIndex = 0;
+
+	for (int k = 1; k < 4; k++) {
+		if (coords[k] == HotspotCoords::MissingCoord)
+			continue;
+
+		int kxmin = 4*(coords[k]*scales[k] - scales[k]/2 - a - base[k]) - frac[k];
+		int kxmax = kxmin + 4*scales[k];
+		while (kxmin > quarterCount - quarterCount/2) kxmin -= quarterCount;
+		while (kxmax > quarterCount - quarterCount/2) kxmax -= quarterCount;
+		while (kxmin < -quarterCount/2) kxmin += quarterCount;
+		while (kxmax < -quarterCount/2) kxmax += quarterCount;
+		if (kxmin > xmin) {
+			xmin = kxmin;
+			lowIndex = k;
+		}
+		if (kxmax < xmax) {
+			xmax = kxmax;
+			highIndex = k;
+		}
+	}
+
+	if (xmax <= xmin)
+		return false;
+
+	// the factor is xmax - xmin = const + x[lowIndex] - x[highIndex] on the
+	// whole simplex, so move from the centroid to each vertex
+	for (int j = 0; j < 4; j++) {
+		int lowShift = (j >= step[lowIndex] ? 4 : 0) - frac[lowIndex];
+		int highShift = (j >= step[highIndex] ? 4 : 0) - frac[highIndex];
+		values[j] = (xmax - xmin + lowShift - highShift)/4;
+	}
+
+	return true;
+}
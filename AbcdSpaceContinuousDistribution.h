@@ -0,0 +1,63 @@
+#ifndef __ABCD_SPACE_CONTINUOUS_DISTRIBUTION__
+#define __ABCD_SPACE_CONTINUOUS_DISTRIBUTION__
+
+
+#include <vector>
+#include "Common.h"
+#include "ObservedHotspots.h"
+#include "AbcdSpaceLimits.h"
+
+// Integrates the continuous (gridRes -> infinity) abcd space distribution
+// cell by cell.  On a lattice with CellRes subdivisions every breakpoint of
+// the likelihood lies on a plane ba, ca, da, ca-ba, da-ba or da-ca = integer,
+// so each lattice cube splits into 6 simplices on which all min/max and wrap
+// choices are fixed and every factor is affine.
+class AbcdSpaceContinuousDistribution {
+public:
+	AbcdSpaceContinuousDistribution(const ObservedHotspots &observedHotspots, const AbcdSpaceLimitsInt &limits, int order);
+
+	Double CalculateHotspotProbability(const HotspotCoords coord, Double prob = 0);
+
+	long int GetNumCells();
+	long int GetNumCandidateCells();
+	int GetOrder();
+
+	static const int CellRes = 2;
+
+private:
+	struct AbcdSpaceCell {
+		int ba;
+		int ca;
+		int da;
+		int perm;
+
+		// integral of the likelihood times each barycentric coordinate
+		Double moments[4];
+	};
+
+	struct ObservationCollector {
+		std::vector<HotspotCoords>* observations;
+
+		void operator()(const HotspotCoordsWithDate &coord) {
+			observations->push_back(coord);
+		}
+	};
+
+	void FindCells(const AbcdSpaceLimitsInt &limsInt);
+	void ComputeMoments();
+	void CalculateQuadratureNodes();
+	bool CalculateFactor(const HotspotCoords &coord, const AbcdSpaceCell &cell, Double values[4]);
+
+	std::vector<HotspotCoords> observations;
+	std::vector<AbcdSpaceCell> cells;
+
+	std::vector<Double> nodeLambdas;
+	std::vector<Double> nodeWeights;
+
+	long int numCandidateCells;
+	int order;
+	int LimitCount;
+};
+
+
+#endif
@@ -2,19 +2,21 @@
 #include <cstdlib>
 #include "AbcdSpaceLimits.h"
 
-AbcdSpaceLimits::AbcdSpaceLimits(ObservedHotspots observedHotspots, bool printOut) {
+AbcdSpaceLimits::AbcdSpaceLimits(const ObservedHotspots &observedHotspots, bool printOut) {
 	for (int i = 0 ; i < 4; i++) {
 		for (int j = 0; j < 4; j++) {
 			limits[i][j] = std::numeric_limits<Double>::infinity();
 		}
 	}
 	
-	observedHotspots.Iterate(AdjustLimitsSingleHotspot, &limits);
+	LimitsAdjuster adjuster;
+	adjuster.limits = limits;
+	observedHotspots.Visit(adjuster);
 	
 	PairwiseCombineLimits(printOut);
 }
 
-void AbcdSpaceLimits::PrintToFile(std::string filename){
+void AbcdSpaceLimits::PrintToFile(std::string filename) const {
 	FILE* file = fopen(filename.c_str(), "w");
 	if(!file) {
 		printf("Error: Could not open file for writing: \"%s\"\n", filename.c_str());
@@ -28,7 +30,7 @@ void AbcdSpaceLimits::PrintToFile(std::string filename){
 	printf("Printed limits to file: \"%s\".\n", filename.c_str());
 }
 
-void AbcdSpaceLimits::PrintToFile(FILE* file){
+void AbcdSpaceLimits::PrintToFile(FILE* file) const {
 	char letter[4] = {'a','b','c','d'};
 	
 	for (int i = 0 ; i < 4; i++) {
@@ -39,7 +41,7 @@ void AbcdSpaceLimits::PrintToFile(FILE* file){
 	}
 }
 
-AbcdSpaceLimitsInt AbcdSpaceLimits::GenerateAbcdSpaceLimitsInt(int scale) {
+AbcdSpaceLimitsInt AbcdSpaceLimits::GenerateAbcdSpaceLimitsInt(int scale) const {
 	AbcdSpaceLimitsInt returnval;
 	for (int i = 0 ; i < 4; i++) {
 		for (int j = 0; j < 4; j++) {
@@ -49,7 +51,7 @@ AbcdSpaceLimitsInt AbcdSpaceLimits::GenerateAbcdSpaceLimitsInt(int scale) {
 	return returnval;
 }
 
-bool AbcdSpaceLimits::CheckHotspot(HotspotCoords coord, bool matchEntireAllowedSpace) {
+bool AbcdSpaceLimits::CheckHotspot(const HotspotCoords &coord, bool matchEntireAllowedSpace) const {
 	Coord* coordArray = coord.GetCoordArray();
 	const short* numCoordsArray = HotspotCoords::GetNumCoordsArray();
 	AbcdSpaceLimitsInt limitsInt = GenerateAbcdSpaceLimitsInt(1); 
@@ -79,9 +81,18 @@ bool AbcdSpaceLimits::CheckHotspot(HotspotCoords coord, bool matchEntireAllowedS
 	return true;
 }
 
-void AbcdSpaceLimits::AdjustLimitsSingleHotspot(HotspotCoordsWithDate coord, void* data) {
-	Double (*limits)[4] = (Double(*)[4])data;
-	
+// whether the observations limit every coordinate relative to every other
+bool AbcdSpaceLimits::IsBounded() const {
+	for (int i = 0 ; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			if (i != j && limits[i][j] == std::numeric_limits<Double>::infinity())
+				return false;
+		}
+	}
+	return true;
+}
+
+void AbcdSpaceLimits::LimitsAdjuster::operator()(const HotspotCoordsWithDate &coord) {
 	Coord* coordArray = coord.GetCoordArray();
 	const short* numCoordsArray = HotspotCoords::GetNumCoordsArray();
 	
@@ -112,6 +123,9 @@ void AbcdSpaceLimits::PairwiseCombineLimits(bool printOut) {
 			for (int j = 0; j < 4; j++) {
 				for (int k = 0; k < 4; k++) {
 					Double newLimit = limits[i][k] + limits[k][j];
+					// an unbounded pair, as before enough observations, stays so
+					if (newLimit == std::numeric_limits<Double>::infinity())
+						continue;
 					while (newLimit < 0) newLimit += 1.0;
 					while (newLimit >= 1.0) newLimit -= 1.0;
 					if(newLimit < limits[i][j]) {
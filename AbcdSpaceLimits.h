@@ -10,16 +10,27 @@
 
 class AbcdSpaceLimits {
 public:
-	AbcdSpaceLimits(ObservedHotspots observedHotspots, bool printOut = true);
+	AbcdSpaceLimits(const ObservedHotspots &observedHotspots, bool printOut = true);
 	
-	void PrintToFile(std::string filename);
-	void PrintToFile(FILE* file);
+	void PrintToFile(std::string filename) const;
+	void PrintToFile(FILE* file) const;
 	
-	AbcdSpaceLimitsInt GenerateAbcdSpaceLimitsInt(int scale);
-	bool CheckHotspot(HotspotCoords coords, bool matchEntireAllowedSpace);
+	AbcdSpaceLimitsInt GenerateAbcdSpaceLimitsInt(int scale) const;
+	bool CheckHotspot(const HotspotCoords &coords, bool matchEntireAllowedSpace) const;
+	bool IsBounded() const;
 	
 private:
-	void static AdjustLimitsSingleHotspot(HotspotCoordsWithDate coord, void* data);
+	// the limits are owned by a single object, passed by reference
+	AbcdSpaceLimits(const AbcdSpaceLimits &other);
+	AbcdSpaceLimits& operator=(const AbcdSpaceLimits &other);
+	
+	// narrows the limits to those allowed by each observation
+	struct LimitsAdjuster {
+		Double (*limits)[4];
+		
+		void operator()(const HotspotCoordsWithDate &coord);
+	};
+	
 	void PairwiseCombineLimits(bool printOut);
 	
 	// limits indicates how much higher 
@@ -1,44 +1,127 @@
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <cmath>
+#include <algorithm>
 #include "AbcdSpaceProbabilityDistribution.h"
+#include "ReproducibleSum.h"
+#include "FixedWidthWriter.h"
+#include "ThreadPlacement.h"
+#ifdef using_parallel
+	#include <omp.h>
+#endif
 
-AbcdSpaceProbabilityDistribution::AbcdSpaceProbabilityDistribution(ObservedHotspots observedHotspots, AbcdSpaceLimits limits, 
-																   int gridRes, int increment, bool normalize){
+const Double AbcdSpaceProbabilityDistribution::ScaleFactor = 3.2*HotspotCoords::NumLongs;
+
+// the terms of the prior's weighted log, as terms of a ReproducibleSum
+struct PriorWeightedLogs {
+	const AbcdProb* probs;
+	const std::vector<AbcdProb>* logProbs;
+	
+	PriorWeightedLogs(const AbcdProb* inProbs, const std::vector<AbcdProb>* inLogProbs) : probs(inProbs), logProbs(inLogProbs) {}
+	
+	Double operator[](long int i) const {
+		return (Double)probs[i]*(*logProbs)[i];
+	}
+};
+
+AbcdSpaceProbabilityDistribution::AbcdSpaceProbabilityDistribution(const ObservationTable &observations, const AbcdSpaceLimits &limits, 
+																   int gridRes, int increment, bool normalize, LikelihoodCache* cache){
+	this->gridRes = gridRes;
 	LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*gridRes;
-	CalculateProbabilityDistribution(observedHotspots, limits, gridRes, increment, normalize);
+	CalculateProbabilityDistribution(observations, limits, gridRes, increment, normalize, cache);
 }
 
-AbcdSpaceProbabilityDistribution::AbcdSpaceProbabilityDistribution(ObservedHotspots observedHotspots, AbcdSpaceLimitsInt limits, 
-																   int gridRes, int increment, bool normalize){
+AbcdSpaceProbabilityDistribution::AbcdSpaceProbabilityDistribution(const ObservationTable &observations, const AbcdSpaceLimitsInt &limits, 
+																   int gridRes, int increment, bool normalize, LikelihoodCache* cache){
+	this->gridRes = gridRes;
 	LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*gridRes;
-	CalculateProbabilityDistribution(observedHotspots, limits, gridRes, increment, normalize);
+	CalculateProbabilityDistribution(observations, limits, gridRes, increment, normalize, cache);
 }
 
 AbcdSpaceProbabilityDistribution::~AbcdSpaceProbabilityDistribution() {
-	delete[] probPoints;
+	delete[] probs;
 }
 
 long int AbcdSpaceProbabilityDistribution::GetNumPoints() {
+	return numGridPoints;
+}
+
+long int AbcdSpaceProbabilityDistribution::GetNumNonzeroPoints() {
 	return numProbPoints;
 }
 
 void AbcdSpaceProbabilityDistribution::PrintToFile(std::string filename){
-	FILE* file = fopen(filename.c_str(), "w");
-	if(!file) {
-		printf("Error: Could not open file for writing: \"%s\"\n", filename.c_str());
-		exit(EXIT_FAILURE);
+	WriteFixedWidthFile(filename, "", numProbPoints, LineFormatter::LineWidth, LineFormatter(this));
+	
+	printf("Probability distribution contains %ld points, %ld with nonzero probability.\n", numGridPoints, numProbPoints);
+	printf("Printed probability distribution to file: \"%s\".\n", filename.c_str());
+}
+
+AbcdSpaceProbabilityDistribution::LineFormatter::LineFormatter(const AbcdSpaceProbabilityDistribution* inDistribution) :
+	distribution(inDistribution)
+{
+	int maxCoords[3];
+	for (int j = 0; j < 3; j++) {
+		minCoords[j] = INT_MAX;
+		maxCoords[j] = INT_MIN;
+	}
+	const std::vector<AbcdSpaceRow> &rows = distribution->rows;
+	for (std::vector<AbcdSpaceRow>::const_iterator row = rows.begin(); row < rows.end(); row++) {
+		int lastDa = row->firstDa + (row->count - 1)*distribution->increment;
+		minCoords[0] = std::min(minCoords[0], row->ba);
+		maxCoords[0] = std::max(maxCoords[0], row->ba);
+		minCoords[1] = std::min(minCoords[1], row->ca);
+		maxCoords[1] = std::max(maxCoords[1], row->ca);
+		minCoords[2] = std::min(minCoords[2], row->firstDa);
+		maxCoords[2] = std::max(maxCoords[2], lastDa);
 	}
 	
-	for(long int i=0; i<numProbPoints; i++){
-		AbcdSpacePoint point = probPoints[i];
-		fprintf(file, "%44.36Lf %44.36Lf %44.36Lf %47.36Le\n", ((Double)point.ba)/LimitCount,
-				((Double)point.ca)/LimitCount, ((Double)point.da)/LimitCount, point.prob);
+	for (int j = 0; j < 3 && !rows.empty(); j++) {
+		int numValues = maxCoords[j] - minCoords[j] + 1;
+		coordTables[j].resize((long int)numValues*CoordWidth);
+		
+		#ifdef using_parallel
+		#pragma omp parallel for
+		#endif
+		for (int i = 0; i < numValues; i++) {
+			FormatFixedWidth(&coordTables[j][(long int)i*CoordWidth], CoordWidth, "%44.36Lf",
+							 ((Double)(minCoords[j] + i))/distribution->LimitCount);
+		}
 	}
+}
+
+void AbcdSpaceProbabilityDistribution::LineFormatter::Format(long int begin, long int end, char* buffer) const {
+	const std::vector<AbcdSpaceRow> &rows = distribution->rows;
 	
-	fclose(file);
+	// last row starting at or before the first point
+	long int low = 0;
+	long int high = rows.size();
+	while (high - low > 1) {
+		long int mid = low + (high - low)/2;
+		if (rows[mid].start <= begin)
+			low = mid;
+		else
+			high = mid;
+	}
 	
-	printf("Probability distribution contains %ld points.\n", numProbPoints);
-	printf("Printed probability distribution to file: \"%s\".\n", filename.c_str());
+	long int r = low;
+	for (long int i = begin; i < end; i++) {
+		while (i >= rows[r].start + rows[r].count)
+			r++;
+		const AbcdSpaceRow &row = rows[r];
+		int coords[3] = {row.ba, row.ca, row.firstDa + (int)(i - row.start)*distribution->increment};
+		
+		for (int j = 0; j < 3; j++) {
+			memcpy(buffer, &coordTables[j][(long int)(coords[j] - minCoords[j])*CoordWidth], CoordWidth);
+			buffer[CoordWidth] = ' ';
+			buffer += CoordWidth + 1;
+		}
+		FormatFixedWidth(buffer, ProbWidth, "%47.36Le", (Double)distribution->probs[i]);
+		buffer[ProbWidth] = '\n';
+		buffer += ProbWidth + 1;
+	}
 }
 
 Double AbcdSpaceProbabilityDistribution::CalculateHotspotProbability(const HotspotCoords coord, Double prob) {
@@ -51,128 +134,540 @@ Double AbcdSpaceProbabilityDistribution::CalculateHotspotProbability(const Hotsp
 		exit(EXIT_FAILURE);
 	}
 	
-	for(long int i=0; i<numProbPoints; i++){
-		AbcdSpacePoint point = probPoints[i];
+	switch (gridRes) {
+		case 1: return CalculateHotspotProbability(GridScale<1>(gridRes), coord, prob);
+		case 5: return CalculateHotspotProbability(GridScale<5>(gridRes), coord, prob);
+		case 10: return CalculateHotspotProbability(GridScale<10>(gridRes), coord, prob);
+		case 20: return CalculateHotspotProbability(GridScale<20>(gridRes), coord, prob);
+		case 50: return CalculateHotspotProbability(GridScale<50>(gridRes), coord, prob);
+		case 100: return CalculateHotspotProbability(GridScale<100>(gridRes), coord, prob);
+		default: return CalculateHotspotProbability(GridScale<0>(gridRes), coord, prob);
+	}
+}
+
+template <class Scale>
+Double AbcdSpaceProbabilityDistribution::CalculateHotspotProbability(const Scale &scale, const HotspotCoords &coord, Double prob) {
+	int latScale = scale.LatScale();
+	int longScale = scale.LongScale();
+	
+	int a = coord.moonLat*latScale;
+	int bLow = coord.moonLong*longScale - longScale/2 - a;
+	int cLow = coord.marsLat*latScale - latScale/2 - a;
+	int dLow = coord.marsLong*longScale - longScale/2 - a;
+	
+	for(std::vector<AbcdSpaceRow>::iterator row = rows.begin(); row < rows.end(); row++){
+		// b & c are fixed along a row, so only the da bounds vary per point
+		int rowxmin = -latScale/2;
+		int rowxmax = latScale - latScale/2;
+		
+		rowxmin = std::max(rowxmin, scale.Wrap(bLow - row->ba));
+		rowxmax = std::min(rowxmax, scale.Wrap(bLow + longScale - row->ba));
+		rowxmin = std::max(rowxmin, scale.Wrap(cLow - row->ca));
+		rowxmax = std::min(rowxmax, scale.Wrap(cLow + latScale - row->ca));
 		
-		int latScale = LimitCount/HotspotCoords::NumLats;
-		int longScale = LimitCount/HotspotCoords::NumLongs;
+		if(rowxmax <= rowxmin)
+			continue;
 		
+		for(int k=0; k<row->count; k++){
+			int da = row->firstDa + k*increment;
+			int xmin = std::max(rowxmin, scale.Wrap(dLow - da));
+			int xmax = std::min(rowxmax, scale.Wrap(dLow + longScale - da));
+			
+			if(xmax>xmin)
+				prob += probs[row->start + k]*(xmax-xmin);
+		}
+	}
+	
+	return prob;
+}
+
+void AbcdSpaceProbabilityDistribution::SumRows() {
+	long int numRows = rows.size();
+	rowSums.resize(numRows);
+	
+	#ifdef using_parallel
+	#pragma omp parallel for
+	#endif
+	for (long int r=0; r<numRows; r++) {
+		Double sum = 0;
+		for (int k=0; k<rows[r].count; k++)
+			sum += probs[rows[r].start + k];
+		rowSums[r] = sum;
+	}
+}
+
+Double AbcdSpaceProbabilityDistribution::CalculateBlockProbability(const HotspotCoords coord, Double prob) {
+	if (coord.moonLat == HotspotCoords::MissingCoord ||
+		coord.moonLong == HotspotCoords::MissingCoord ||
+		coord.marsLong != HotspotCoords::MissingCoord) {
+		printf("Error: Block coordinates must have the moon coordinates and no mars longitude: (%d, %d, %d, %d)\n", 
+			   coord.moonLat, coord.moonLong, coord.marsLat, coord.marsLong);
+		exit(EXIT_FAILURE);
+	}
+	if (rowSums.size() != rows.size()) {
+		printf("Error: The rows must be summed before calculating block probabilities.\n");
+		exit(EXIT_FAILURE);
+	}
+	
+	switch (gridRes) {
+		case 1: return CalculateBlockProbability(GridScale<1>(gridRes), coord, prob);
+		case 5: return CalculateBlockProbability(GridScale<5>(gridRes), coord, prob);
+		case 10: return CalculateBlockProbability(GridScale<10>(gridRes), coord, prob);
+		case 20: return CalculateBlockProbability(GridScale<20>(gridRes), coord, prob);
+		case 50: return CalculateBlockProbability(GridScale<50>(gridRes), coord, prob);
+		case 100: return CalculateBlockProbability(GridScale<100>(gridRes), coord, prob);
+		default: return CalculateBlockProbability(GridScale<0>(gridRes), coord, prob);
+	}
+}
+
+// the mars cells tile the whole range of c & d, so summing a hotspot's
+// overlap over the cells left out leaves only the b & c bounds, which are
+// fixed along a row
+template <class Scale>
+Double AbcdSpaceProbabilityDistribution::CalculateBlockProbability(const Scale &scale, const HotspotCoords &coord, Double prob) {
+	int latScale = scale.LatScale();
+	int longScale = scale.LongScale();
+	
+	int a = coord.moonLat*latScale;
+	int bLow = coord.moonLong*longScale - longScale/2 - a;
+	int cLow = coord.marsLat*latScale - latScale/2 - a;
+	bool hasMarsLat = coord.marsLat != HotspotCoords::MissingCoord;
+	
+	for(unsigned int r=0; r<rows.size(); r++){
+		const AbcdSpaceRow &row = rows[r];
 		int xmin = -latScale/2;
 		int xmax = latScale - latScale/2;
 		
-		int a = coord.moonLat*latScale;
-		int b = a + point.ba;
-		int c = a + point.ca;
-		int d = a + point.da;
-		
-		int bxmin = coord.moonLong*longScale - longScale/2 - b;
-		int bxmax = coord.moonLong*longScale + longScale - longScale/2 - b;
-		while (bxmin > LimitCount - LimitCount/2) bxmin -= LimitCount;
-		while (bxmax > LimitCount - LimitCount/2) bxmax -= LimitCount;
-		while (bxmin < -LimitCount/2) bxmin += LimitCount;
-		while (bxmax < -LimitCount/2) bxmax += LimitCount;
-		if(bxmin > xmin) xmin = bxmin;
-		if(bxmax < xmax) xmax = bxmax;
-		
-		int cxmin = coord.marsLat*latScale - latScale/2 - c;
-		int cxmax = coord.marsLat*latScale + latScale - latScale/2 - c;
-		while (cxmin > LimitCount - LimitCount/2) cxmin -= LimitCount;
-		while (cxmax > LimitCount - LimitCount/2) cxmax -= LimitCount;
-		while (cxmin < -LimitCount/2) cxmin += LimitCount;
-		while (cxmax < -LimitCount/2) cxmax += LimitCount;
-		if(cxmin > xmin) xmin = cxmin;
-		if(cxmax < xmax) xmax = cxmax;
-		
-		int dxmin = coord.marsLong*longScale - longScale/2 - d;
-		int dxmax = coord.marsLong*longScale + longScale - longScale/2 - d;
-		while (dxmin > LimitCount - LimitCount/2) dxmin -= LimitCount;
-		while (dxmax > LimitCount - LimitCount/2) dxmax -= LimitCount;
-		while (dxmin < -LimitCount/2) dxmin += LimitCount;
-		while (dxmax < -LimitCount/2) dxmax += LimitCount;
-		if(dxmin > xmin) xmin = dxmin;
-		if(dxmax < xmax) xmax = dxmax;
+		xmin = std::max(xmin, scale.Wrap(bLow - row.ba));
+		xmax = std::min(xmax, scale.Wrap(bLow + longScale - row.ba));
+		if (hasMarsLat) {
+			xmin = std::max(xmin, scale.Wrap(cLow - row.ca));
+			xmax = std::min(xmax, scale.Wrap(cLow + latScale - row.ca));
+		}
 		
 		if(xmax>xmin)
-			prob += point.prob*(xmax-xmin);
+			prob += rowSums[r]*(xmax-xmin);
 	}
 	
 	return prob;
 }
 
-void AbcdSpaceProbabilityDistribution::CalculateProbabilityDistribution(ObservedHotspots observedHotspots, AbcdSpaceLimits limits, 
-																		int gridRes, int increment, bool normalize) {
-	AbcdSpaceLimitsInt limsInt = limits.GenerateAbcdSpaceLimitsInt(gridRes);
-	CalculateProbabilityDistribution(observedHotspots, limsInt, gridRes, increment, normalize);
-}
+void AbcdSpaceProbabilityDistribution::AccumulateObservations(const std::vector<HotspotCoords> &candidates, ObservationTerms* prior,
+															  std::vector<ObservationTerms>* terms) {
+	// the zero points have been removed, so the logs, stored as AbcdProb
+	// like the probabilities, fit in the second copy CalculateMemoryUsage
+	// counts for the removal
+	std::vector<AbcdProb> logProbs(numProbPoints);
 	
-void AbcdSpaceProbabilityDistribution::CalculateProbabilityDistribution(ObservedHotspots observedHotspots, AbcdSpaceLimitsInt limsInt, 
-																		int gridRes, int increment, bool normalize) {
-	std::vector<long int> starts;
-	numProbPoints = CalculateNumberOfAbcdPoints(limsInt, gridRes, increment, &starts);
+	#ifdef using_parallel
+	#pragma omp parallel for
+	#endif
+	for (long int i=0; i<numProbPoints; i++)
+		logProbs[i] = logl((Double)probs[i]);
+	
+	prior->evidence += ReproducibleSum(probs, numProbPoints);
+	prior->weightedLog += ReproducibleSum(PriorWeightedLogs(probs, &logProbs), numProbPoints);
+	prior->support += numProbPoints;
+	
+	switch (gridRes) {
+		case 1: AccumulateObservations(GridScale<1>(gridRes), candidates, logProbs, terms); break;
+		case 5: AccumulateObservations(GridScale<5>(gridRes), candidates, logProbs, terms); break;
+		case 10: AccumulateObservations(GridScale<10>(gridRes), candidates, logProbs, terms); break;
+		case 20: AccumulateObservations(GridScale<20>(gridRes), candidates, logProbs, terms); break;
+		case 50: AccumulateObservations(GridScale<50>(gridRes), candidates, logProbs, terms); break;
+		case 100: AccumulateObservations(GridScale<100>(gridRes), candidates, logProbs, terms); break;
+		default: AccumulateObservations(GridScale<0>(gridRes), candidates, logProbs, terms); break;
+	}
+}
 
-	probPoints = new AbcdSpacePoint[numProbPoints];
+// each batch of candidates is swept over the rows together, so that a
+// row's probabilities & their logs are read from memory once for the batch;
+// a point's weight is probs*width, whose log is logProbs + log(width)
+template <class Scale>
+void AbcdSpaceProbabilityDistribution::AccumulateObservations(const Scale &scale, const std::vector<HotspotCoords> &candidates,
+															  const std::vector<AbcdProb> &logProbs, std::vector<ObservationTerms>* terms) {
+	int latScale = scale.LatScale();
+	int longScale = scale.LongScale();
 	
-	long int count = 0;
-	for (int ba = LimitCount - limsInt.limits[0][1] + increment; ba < limsInt.limits[1][0]; ba += increment) {
-		for (int ca = LimitCount - limsInt.limits[0][2] + increment; ca < limsInt.limits[2][0]; ca += increment) {
-			for (int da = LimitCount - limsInt.limits[0][3] + increment; da < limsInt.limits[3][0]; da += increment) {
-				if (ca-ba > LimitCount - limsInt.limits[1][2] && ca-ba < limsInt.limits[2][1] && 
-					da-ba > LimitCount - limsInt.limits[1][3] && da-ba < limsInt.limits[3][1] &&
-					da-ca > LimitCount - limsInt.limits[2][3] && da-ca < limsInt.limits[3][2]) {
+	std::vector<Double> logWidths(latScale + 1, 0);
+	for (int w = 1; w <= latScale; w++)
+		logWidths[w] = logl((Double)w);
+	
+	long int numCandidates = candidates.size();
+	long int numBatches = (numCandidates + ObservationBatchSize - 1)/ObservationBatchSize;
+	
+	#ifdef using_parallel
+	#pragma omp parallel for schedule(dynamic)
+	#endif
+	for (long int batch = 0; batch < numBatches; batch++) {
+		long int first = batch*ObservationBatchSize;
+		int count = std::min((long int)ObservationBatchSize, numCandidates - first);
+		
+		int bLow[ObservationBatchSize], cLow[ObservationBatchSize], dLow[ObservationBatchSize];
+		ObservationTerms sums[ObservationBatchSize];
+		for (int j = 0; j < count; j++) {
+			const HotspotCoords &coord = candidates[first + j];
+			int a = coord.moonLat*latScale;
+			bLow[j] = coord.moonLong*longScale - longScale/2 - a;
+			cLow[j] = coord.marsLat*latScale - latScale/2 - a;
+			dLow[j] = coord.marsLong*longScale - longScale/2 - a;
+			sums[j] = (*terms)[first + j];
+		}
+		
+		for(std::vector<AbcdSpaceRow>::iterator row = rows.begin(); row < rows.end(); row++){
+			const AbcdProb* rowProbs = &probs[row->start];
+			const AbcdProb* rowLogProbs = &logProbs[row->start];
+			
+			for (int j = 0; j < count; j++) {
+				int rowxmin = -latScale/2;
+				int rowxmax = latScale - latScale/2;
+				
+				rowxmin = std::max(rowxmin, scale.Wrap(bLow[j] - row->ba));
+				rowxmax = std::min(rowxmax, scale.Wrap(bLow[j] + longScale - row->ba));
+				rowxmin = std::max(rowxmin, scale.Wrap(cLow[j] - row->ca));
+				rowxmax = std::min(rowxmax, scale.Wrap(cLow[j] + latScale - row->ca));
+				
+				if(rowxmax <= rowxmin)
+					continue;
+				
+				Double evidence = sums[j].evidence;
+				Double weightedLog = sums[j].weightedLog;
+				long int support = sums[j].support;
+				for(int k=0; k<row->count; k++){
+					int da = row->firstDa + k*increment;
+					int xmin = std::max(rowxmin, scale.Wrap(dLow[j] - da));
+					int xmax = std::min(rowxmax, scale.Wrap(dLow[j] + longScale - da));
 					
-					AbcdSpacePoint point(ba, ca, da, 1.0);
-					probPoints[count] = point;
-					count++;
+					if(xmax>xmin) {
+						Double weight = rowProbs[k]*(xmax-xmin);
+						evidence += weight;
+						weightedLog += weight*(rowLogProbs[k] + logWidths[xmax-xmin]);
+						support++;
+					}
 				}
+				sums[j].evidence = evidence;
+				sums[j].weightedLog = weightedLog;
+				sums[j].support = support;
 			}
 		}
+		
+		for (int j = 0; j < count; j++)
+			(*terms)[first + j] = sums[j];
 	}
+}
+
+// the coordinate of the cell of the given size holding x, that of v covering
+// [v*size - size/2, ... + size)
+static int CellCoord(int x, int size) {
+	int numer = x + size/2;
+	return numer/size - (numer % size < 0 ? 1 : 0);
+}
+
+// the index of a coordinate among numCoords around the circle from minCoord
+static int CellIndex(int coord, int minCoord, int numCoords) {
+	return ((coord - minCoord) % numCoords + numCoords) % numCoords;
+}
+
+// adds weight times the overlap of [low, high) with each longitude cell,
+// that of long covering [long*longScale - longScale/2, ... + longScale)
+// around the circle, to row[long - MinLong]
+static void ScatterOverLongs(int low, int high, int longScale, Double weight, Double* row) {
+	int longCoord = CellCoord(low, longScale);
+	for (int start = longCoord*longScale - longScale/2; start < high; start += longScale, longCoord++) {
+		int overlap = std::min(high, start + longScale) - std::max(low, start);
+		row[CellIndex(longCoord, HotspotCoords::MinLong, HotspotCoords::NumLongs)] += weight*overlap;
+	}
+}
+
+// the moon longitude is at b = a + ba, where a covers the moon latitude's
+// cell, so the moon location depends only on ba
+void AbcdSpaceProbabilityDistribution::AccumulateMoonMarginal(std::vector<Double>* cells) {
+	if (rows.empty())
+		return;
+	int latScale = LimitCount/HotspotCoords::NumLats;
+	int longScale = LimitCount/HotspotCoords::NumLongs;
+	
+	int minBa = rows.front().ba;
+	int maxBa = rows.front().ba;
+	for (std::vector<AbcdSpaceRow>::iterator row = rows.begin(); row < rows.end(); row++) {
+		minBa = std::min(minBa, row->ba);
+		maxBa = std::max(maxBa, row->ba);
+	}
+	std::vector<Double> baSums(maxBa - minBa + 1, 0);
+	for (std::vector<AbcdSpaceRow>::iterator row = rows.begin(); row < rows.end(); row++) {
+		for (int k=0; k<row->count; k++)
+			baSums[row->ba - minBa] += probs[row->start + k];
+	}
+	
+	for (int i = 0; i < (int)baSums.size(); i++) {
+		if (baSums[i] == 0)
+			continue;
+		for (int moonLat = HotspotCoords::MinLat; moonLat <= HotspotCoords::MaxLat; moonLat++) {
+			int low = moonLat*latScale + minBa + i - latScale/2;
+			ScatterOverLongs(low, low + latScale, longScale, baSums[i],
+							 &(*cells)[(moonLat - HotspotCoords::MinLat)*HotspotCoords::NumLongs]);
+		}
+	}
+}
+
+// the mars location is at c = a + ca & d = a + da, where a covers the
+// whole circle over all moon latitudes, so d = c + da - ca for every c in
+// the mars latitude's cell, and the mars location depends only on da - ca
+void AbcdSpaceProbabilityDistribution::AccumulateMarsMarginal(std::vector<Double>* cells) {
+	if (rows.empty())
+		return;
+	int latScale = LimitCount/HotspotCoords::NumLats;
+	int longScale = LimitCount/HotspotCoords::NumLongs;
+	
+	int minDiff = rows.front().firstDa - rows.front().ca;
+	int maxDiff = minDiff;
+	for (std::vector<AbcdSpaceRow>::iterator row = rows.begin(); row < rows.end(); row++) {
+		minDiff = std::min(minDiff, row->firstDa - row->ca);
+		maxDiff = std::max(maxDiff, row->firstDa + (row->count - 1)*increment - row->ca);
+	}
+	std::vector<Double> diffSums(maxDiff - minDiff + 1, 0);
+	for (std::vector<AbcdSpaceRow>::iterator row = rows.begin(); row < rows.end(); row++) {
+		int first = row->firstDa - row->ca - minDiff;
+		for (int k=0; k<row->count; k++)
+			diffSums[first + k*increment] += probs[row->start + k];
+	}
+	
+	for (int i = 0; i < (int)diffSums.size(); i++) {
+		if (diffSums[i] == 0)
+			continue;
+		for (int marsLat = HotspotCoords::MinLat; marsLat <= HotspotCoords::MaxLat; marsLat++) {
+			int low = marsLat*latScale - latScale/2 + minDiff + i;
+			ScatterOverLongs(low, low + latScale, longScale, diffSums[i],
+							 &(*cells)[(marsLat - HotspotCoords::MinLat)*HotspotCoords::NumLongs]);
+		}
+	}
+}
+
+// with the moon location known, each point leaves the x within its moon
+// cell, along which c = a + x + ca & d = a + x + da cross a few mars cells
+void AbcdSpaceProbabilityDistribution::AccumulateConditionalMarsMarginal(const HotspotCoords &moon, std::vector<Double>* cells) {
+	GridScale<0> scale(gridRes);
+	int latScale = scale.LatScale();
+	int longScale = scale.LongScale();
+	
+	int a = moon.moonLat*latScale;
+	int bLow = moon.moonLong*longScale - longScale/2 - a;
 	
-	this->ComputeProbabilities(observedHotspots);
+	for(std::vector<AbcdSpaceRow>::iterator row = rows.begin(); row < rows.end(); row++){
+		int xmin = std::max(-latScale/2, scale.Wrap(bLow - row->ba));
+		int xmax = std::min(latScale - latScale/2, scale.Wrap(bLow + longScale - row->ba));
+		if(xmax <= xmin)
+			continue;
+		
+		for(int k=0; k<row->count; k++){
+			int cBase = a + row->ca;
+			int dBase = a + row->firstDa + k*increment;
+			for (int x = xmin; x < xmax; ) {
+				int latCoord = CellCoord(cBase + x, latScale);
+				int longCoord = CellCoord(dBase + x, longScale);
+				int cEnd = latCoord*latScale - latScale/2 + latScale;
+				int dEnd = longCoord*longScale - longScale/2 + longScale;
+				int step = std::min(xmax - x, std::min(cEnd - cBase - x, dEnd - dBase - x));
+				
+				int cell = CellIndex(latCoord, HotspotCoords::MinLat, HotspotCoords::NumLats)*HotspotCoords::NumLongs +
+						   CellIndex(longCoord, HotspotCoords::MinLong, HotspotCoords::NumLongs);
+				(*cells)[cell] += probs[row->start + k]*step;
+				x += step;
+			}
+		}
+	}
+}
+
+void AbcdSpaceProbabilityDistribution::CalculateProbabilityDistribution(const ObservationTable &observations, const AbcdSpaceLimits &limits, 
+																		int gridRes, int increment, bool normalize, LikelihoodCache* cache) {
+	AbcdSpaceLimitsInt limsInt = limits.GenerateAbcdSpaceLimitsInt(gridRes);
+	CalculateProbabilityDistribution(observations, limsInt, gridRes, increment, normalize, cache);
+}
+	
+void AbcdSpaceProbabilityDistribution::CalculateProbabilityDistribution(const ObservationTable &observations, const AbcdSpaceLimitsInt &limsInt, 
+																		int gridRes, int inIncrement, bool normalize, LikelihoodCache* cache) {
+	increment = inIncrement;
+	
+	// reserved exactly, so that the rows take no more than CalculateMemoryUsage
+	long int numRows = 0;
+	CalculateNumberOfAbcdPoints(limsInt, gridRes, increment, NULL, &numRows);
+	rows.reserve(numRows);
+	numProbPoints = CalculateNumberOfAbcdPoints(limsInt, gridRes, increment, &rows);
+	numGridPoints = numProbPoints;
+	
+	probs = new AbcdProb[numProbPoints];
+	FirstTouch(probs, numProbPoints);
+	
+	LikelihoodCache::Key key;
+	key.observationsDigest = observations.GetDigest();
+	key.gridRes = gridRes;
+	key.increment = increment;
+	key.limits = limsInt;
+	
+	if (cache == NULL || !cache->Load(key, probs, numProbPoints)) {
+		this->ComputeProbabilities(observations);
+		if (cache != NULL)
+			cache->Store(key, probs, numProbPoints);
+	}
+	RemoveZeroPoints();
 	
 	if(normalize) {
 		Normalize();
 	}
+}
+
+void AbcdSpaceProbabilityDistribution::ComputeProbabilities(const ObservationTable &observations) {
+	switch (gridRes) {
+		case 1: ComputeProbabilities(GridScale<1>(gridRes), observations); break;
+		case 5: ComputeProbabilities(GridScale<5>(gridRes), observations); break;
+		case 10: ComputeProbabilities(GridScale<10>(gridRes), observations); break;
+		case 20: ComputeProbabilities(GridScale<20>(gridRes), observations); break;
+		case 50: ComputeProbabilities(GridScale<50>(gridRes), observations); break;
+		case 100: ComputeProbabilities(GridScale<100>(gridRes), observations); break;
+		default: ComputeProbabilities(GridScale<0>(gridRes), observations); break;
+	}
+}
+
+template <class Scale>
+void AbcdSpaceProbabilityDistribution::ComputeProbabilities(const Scale &scale, const ObservationTable &observations) {
+	long int numRows = rows.size();
 	
-	if(numProbPoints != count) {
-		printf("Error: Anticipated %ld points, actually found %ld.\n", numProbPoints, count);
-		exit(EXIT_FAILURE);
+	// the exact kernel leaves the constant ScaleFactor/LimitCount of every
+	// observation's factor out of its products, to be applied once here,
+	// multiplied out in order since powl rounds differently between libms
+#ifdef using_exact_kernel
+	Double factor = ScaleFactor/scale.LimitCount();
+	Double unit = 1;
+	for (int i = 0; i < observations.GetNumObservations(); i++)
+		unit *= factor;
+#else
+	Double unit = 1;
+#endif
+	
+	#ifdef using_parallel
+	#pragma omp parallel
+	#endif
+	{
+		const ObservationTable &localObservations = observations.GetLocalTable();
+		
+		#ifdef using_parallel
+		#pragma omp for schedule(dynamic)
+		#endif
+		for (long int r=0; r<numRows; r++) {
+			AbcdSpaceRow &row = rows[r];
+			for (int k=0; k<row.count; k++) {
+				PointLikelihood likelihood;
+				likelihood.prob = 1.0;
+				likelihood.LimitCount = scale.LimitCount();
+				if (!localObservations.Multiply(scale, row.ba, row.ca, row.firstDa + k*increment, likelihood))
+					likelihood.prob = 0;
+				probs[row.start + k] = (Double)likelihood.prob*unit;
+			}
+		}
 	}
 }
 
-void AbcdSpaceProbabilityDistribution::ComputeProbabilities(ObservedHotspots observedHotspots) {
+void AbcdSpaceProbabilityDistribution::RemoveZeroPoints() {
+	// each block of rows counts its nonzero points & the runs they form,
+	// a prefix sum over the counts gives each block its output offsets,
+	// and the blocks then copy each run into a row of its own in parallel
+	int numBlocks = 1;
+#ifdef using_parallel
+	numBlocks = omp_get_max_threads();
+#endif
+	long int numRows = rows.size();
+	long int blockSize = (numRows + numBlocks - 1)/numBlocks;
+	std::vector<long int> pointOffsets(numBlocks + 1, 0);
+	std::vector<long int> rowOffsets(numBlocks + 1, 0);
+	
 	#ifdef using_parallel
 	#pragma omp parallel for
 	#endif
-	for (long int i=0; i<numProbPoints; i++) {
-		AbcdSpacePointWithLimitCount data;
-		data.point = &probPoints[i];
-		data.LimitCount = LimitCount;
-		observedHotspots.Iterate(CalculateProbSingleHotspot, &data);
+	for (int block = 0; block < numBlocks; block++) {
+		long int end = std::min((block + 1)*blockSize, numRows);
+		for (long int r = block*blockSize; r < end; r++) {
+			for (int k = 0; k < rows[r].count; k++) {
+				if (probs[rows[r].start + k] != 0) {
+					pointOffsets[block + 1]++;
+					if (k == 0 || probs[rows[r].start + k - 1] == 0)
+						rowOffsets[block + 1]++;
+				}
+			}
+		}
+	}
+	
+	for (int block = 0; block < numBlocks; block++) {
+		pointOffsets[block + 1] += pointOffsets[block];
+		rowOffsets[block + 1] += rowOffsets[block];
 	}
+	
+	long int numNonzeroPoints = pointOffsets[numBlocks];
+	if (numNonzeroPoints == numProbPoints)
+		return;
+	
+	std::vector<AbcdSpaceRow> nonzeroRows(rowOffsets[numBlocks], AbcdSpaceRow(0, 0, 0, 0, 0));
+	AbcdProb* nonzeroProbs = new AbcdProb[numNonzeroPoints];
+	
+	#ifdef using_parallel
+	#pragma omp parallel for
+	#endif
+	for (int block = 0; block < numBlocks; block++) {
+		long int end = std::min((block + 1)*blockSize, numRows);
+		long int pointCount = pointOffsets[block];
+		long int rowCount = rowOffsets[block];
+		for (long int r = block*blockSize; r < end; r++) {
+			AbcdSpaceRow &row = rows[r];
+			for (int k = 0; k < row.count; k++) {
+				if (probs[row.start + k] != 0) {
+					if (k == 0 || probs[row.start + k - 1] == 0) {
+						nonzeroRows[rowCount] = AbcdSpaceRow(row.ba, row.ca, row.firstDa + k*increment, 0, pointCount);
+						rowCount++;
+					}
+					nonzeroRows[rowCount - 1].count++;
+					nonzeroProbs[pointCount++] = probs[row.start + k];
+				}
+			}
+		}
+	}
+	
+	delete[] probs;
+	probs = nonzeroProbs;
+	rows.swap(nonzeroRows);
+	numProbPoints = numNonzeroPoints;
 }
 
 void AbcdSpaceProbabilityDistribution::Normalize() {
-	Double sumProb = 0;
-	for(long int i=0; i<numProbPoints; i++)
-		sumProb += probPoints[i].prob;
+	Double sumProb = ReproducibleSum(probs, numProbPoints);
+	
+	#ifdef using_parallel
+	#pragma omp parallel for
+	#endif
 	for(long int i=0; i<numProbPoints; i++)
-		probPoints[i].prob /= sumProb;
+		probs[i] /= sumProb;
 }
 
-long int AbcdSpaceProbabilityDistribution::CalculateNumberOfAbcdPoints(AbcdSpaceLimits limits, int gridRes, int increment) {
+long int AbcdSpaceProbabilityDistribution::CalculateNumberOfAbcdPoints(const AbcdSpaceLimits &limits, int gridRes, int increment) {
 	AbcdSpaceLimitsInt limsInt = limits.GenerateAbcdSpaceLimitsInt(gridRes);
 	return CalculateNumberOfAbcdPoints(limsInt, gridRes, increment);
 }
 
-long int AbcdSpaceProbabilityDistribution::CalculateNumberOfAbcdPoints(AbcdSpaceLimitsInt limsInt, int gridRes, int increment, std::vector<long int>* starts) {
+long int AbcdSpaceProbabilityDistribution::CalculateMemoryUsage(const AbcdSpaceLimitsInt &limits, int gridRes, int increment) {
+	// the rows & probabilities are held twice at the peak, while
+	// RemoveZeroPoints copies the nonzero runs out of them
+	long int numRows = 0;
+	long int numPoints = CalculateNumberOfAbcdPoints(limits, gridRes, increment, NULL, &numRows);
+	return 2*(numRows*(long int)sizeof(AbcdSpaceRow) + numPoints*(long int)sizeof(AbcdProb));
+}
+
+long int AbcdSpaceProbabilityDistribution::CalculateNumberOfAbcdPoints(const AbcdSpaceLimitsInt &limsInt, int gridRes, int increment, std::vector<AbcdSpaceRow>* rows,
+																	   long int* numRows) {
 	int LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*gridRes;
 	
 	long int count = 0;
+	if (numRows != NULL)
+		*numRows = 0;
 	for (int ba = LimitCount - limsInt.limits[0][1] + increment; ba < limsInt.limits[1][0]; ba += increment) {
 		for (int ca = LimitCount - limsInt.limits[0][2] + increment; ca < limsInt.limits[2][0]; ca += increment) {
-			if (starts!=NULL)
-				starts->push_back(count);
 			if (ca-ba > LimitCount - limsInt.limits[1][2] && ca-ba < limsInt.limits[2][1]){
 				int minDa = LimitCount - limsInt.limits[0][3]; 
 				int maxDa = limsInt.limits[3][0];
@@ -188,73 +683,14 @@ long int AbcdSpaceProbabilityDistribution::CalculateNumberOfAbcdPoints(AbcdSpace
 				if(limsInt.limits[3][2] + ca < maxDa)
 					maxDa = limsInt.limits[3][2] + ca;
 					
-				count += (maxDa-minDa-1)/increment;
+				int rowCount = (maxDa-minDa-1)/increment;
+				if (rows!=NULL && rowCount > 0)
+					rows->push_back(AbcdSpaceRow(ba, ca, minDa + increment, rowCount, count));
+				if (numRows!=NULL && rowCount > 0)
+					(*numRows)++;
+				count += rowCount;
 			}
 		}
 	}
 	return count;
 }
-
-void AbcdSpaceProbabilityDistribution::CalculateProbSingleHotspot(HotspotCoordsWithDate coord, void* data) {
-	static const Double ScaleFactor = 3.2*HotspotCoords::NumLongs;
-	
-	AbcdSpacePointWithLimitCount* ptLim = (AbcdSpacePointWithLimitCount*)data;
-	AbcdSpacePoint* point = ptLim->point;
-	int LimitCount = ptLim->LimitCount;
-	
-	int latScale = LimitCount/HotspotCoords::NumLats;
-	int longScale = LimitCount/HotspotCoords::NumLongs;
-	
-	if (point->prob == 0)
-		return;
-	
-	int xmin = -latScale/2;
-	int xmax = latScale - latScale/2;
-	
-	int a = coord.moonLat*latScale;
-	int b = a + point->ba;
-	int c = a + point->ca;
-	int d = a + point->da;
-	
-	if (coord.moonLat == HotspotCoords::MissingCoord) {
-		printf("Error: coord.moonLat is missing!\n");
-		exit(EXIT_FAILURE);
-	}
-	
-	if (coord.moonLong != HotspotCoords::MissingCoord) {
-		int bxmin = coord.moonLong*longScale - longScale/2 - b;
-		int bxmax = coord.moonLong*longScale + longScale - longScale/2 - b;
-		while (bxmin > LimitCount - LimitCount/2) bxmin -= LimitCount;
-		while (bxmax > LimitCount - LimitCount/2) bxmax -= LimitCount;
-		while (bxmin < -LimitCount/2) bxmin += LimitCount;
-		while (bxmax < -LimitCount/2) bxmax += LimitCount;
-		if(bxmin > xmin) xmin = bxmin;
-		if(bxmax < xmax) xmax = bxmax;
-	}
-	if (coord.marsLat != HotspotCoords::MissingCoord) {
-		int cxmin = coord.marsLat*latScale - latScale/2 - c;
-		int cxmax = coord.marsLat*latScale + latScale - latScale/2 - c;
-		while (cxmin > LimitCount - LimitCount/2) cxmin -= LimitCount;
-		while (cxmax > LimitCount - LimitCount/2) cxmax -= LimitCount;
-		while (cxmin < -LimitCount/2) cxmin += LimitCount;
-		while (cxmax < -LimitCount/2) cxmax += LimitCount;
-		if(cxmin > xmin) xmin = cxmin;
-		if(cxmax < xmax) xmax = cxmax;
-	}
-	if (coord.marsLong != HotspotCoords::MissingCoord) {
-		int dxmin = coord.marsLong*longScale - longScale/2 - d;
-		int dxmax = coord.marsLong*longScale + longScale - longScale/2 - d;
-		while (dxmin > LimitCount - LimitCount/2) dxmin -= LimitCount;
-		while (dxmax > LimitCount - LimitCount/2) dxmax -= LimitCount;
-		while (dxmin < -LimitCount/2) dxmin += LimitCount;
-		while (dxmax < -LimitCount/2) dxmax += LimitCount;
-		if(dxmin > xmin) xmin = dxmin;
-		if(dxmax < xmax) xmax = dxmax;
-	}
-	
-	if(xmax>xmin)
-		point->prob*=(xmax-xmin)*ScaleFactor/LimitCount;
-	else {
-		point->prob = 0;
-	}
-}
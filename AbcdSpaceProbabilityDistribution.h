@@ -5,57 +5,143 @@
 #include <string>
 #include <vector>
 #include "Common.h"
-#include "ObservedHotspots.h"
+#include "ObservationTable.h"
+#include "GridScale.h"
+#include "LikelihoodCache.h"
 #include "AbcdSpaceLimits.h"
 
 class AbcdSpaceProbabilityDistribution {
 public:
-	AbcdSpaceProbabilityDistribution(ObservedHotspots observedHotspots, AbcdSpaceLimits limits, int gridRes, int increment, bool normalize = true);
-	AbcdSpaceProbabilityDistribution(ObservedHotspots observedHotspots, AbcdSpaceLimitsInt limits, int gridRes, int increment, bool normalize = true);
+	AbcdSpaceProbabilityDistribution(const ObservationTable &observations, const AbcdSpaceLimits &limits, int gridRes, int increment,
+									 bool normalize = true, LikelihoodCache* cache = NULL);
+	AbcdSpaceProbabilityDistribution(const ObservationTable &observations, const AbcdSpaceLimitsInt &limits, int gridRes, int increment,
+									 bool normalize = true, LikelihoodCache* cache = NULL);
 	~AbcdSpaceProbabilityDistribution();
 	
 	void PrintToFile(std::string filename);
 	
 	Double CalculateHotspotProbability(const HotspotCoords coord, Double prob = 0);
 	
-	static long int CalculateNumberOfAbcdPoints(AbcdSpaceLimits limits, int gridRes, int increment);
+	// the probability of every hotspot with the given moon coordinates and,
+	// if not missing, mars latitude, which bounds that of each of them;
+	// SumRows must be called first
+	void SumRows();
+	Double CalculateBlockProbability(const HotspotCoords coord, Double prob = 0);
+	
+	// add the probability of each moon location, or each mars location, to
+	// cells[(lat - MinLat)*NumLongs + long - MinLong]
+	void AccumulateMoonMarginal(std::vector<Double>* cells);
+	void AccumulateMarsMarginal(std::vector<Double>* cells);
+	void AccumulateConditionalMarsMarginal(const HotspotCoords &moon, std::vector<Double>* cells);
+	
+	// the terms of the posterior after observing a hotspot, which weighs
+	// each point by its probability times its overlap with the hotspot: the
+	// sum of the weights, which is the evidence for the hotspot, the sum of
+	// weight*log(weight), & the number of points left with a weight
+	struct ObservationTerms {
+		Double evidence;
+		Double weightedLog;
+		long int support;
+		
+		ObservationTerms() : evidence(0), weightedLog(0), support(0) {}
+	};
+	
+	// adds the terms of each candidate's posterior to terms[i], & those of
+	// the prior, weighing each point by its probability, to prior; the
+	// evidence adds up as in CalculateHotspotProbability
+	void AccumulateObservations(const std::vector<HotspotCoords> &candidates, ObservationTerms* prior, std::vector<ObservationTerms>* terms);
+	
+	// the candidates swept over the points together
+	static const int ObservationBatchSize = 16;
+	
+	static long int CalculateNumberOfAbcdPoints(const AbcdSpaceLimits &limits, int gridRes, int increment);
+	static long int CalculateMemoryUsage(const AbcdSpaceLimitsInt &limits, int gridRes, int increment);
 	
 	long int GetNumPoints();
+	long int GetNumNonzeroPoints();
 
 private:
-	struct AbcdSpacePoint {
+	// consecutive points along da sharing the same ba & ca, whose
+	// probabilities are stored densely from probs[start]
+	struct AbcdSpaceRow {
 		int ba;
 		int ca;
-		int da;
-		Double prob;
+		int firstDa;
+		int count;
+		long int start;
 		
-		AbcdSpacePoint(){}
-		
-		AbcdSpacePoint(int inBa, int inCa, int inDa, Double inProb){
+		AbcdSpaceRow(int inBa, int inCa, int inFirstDa, int inCount, long int inStart){
 			ba = inBa;
 			ca = inCa;
-			da = inDa;
-			prob = inProb;
+			firstDa = inFirstDa;
+			count = inCount;
+			start = inStart;
 		}
 	};
 	
-	struct AbcdSpacePointWithLimitCount {
-		AbcdSpacePoint* point;
+	// formats the lines of PrintToFile for WriteFixedWidthFile, copying the
+	// coordinates out of tables formatted once for each distinct value
+	class LineFormatter {
+	public:
+		LineFormatter(const AbcdSpaceProbabilityDistribution* distribution);
+		
+		void Format(long int begin, long int end, char* buffer) const;
+		
+		static const int CoordWidth = 44;
+		static const int ProbWidth = 47;
+		static const int LineWidth = 3*(CoordWidth + 1) + ProbWidth + 1;
+		
+	private:
+		const AbcdSpaceProbabilityDistribution* distribution;
+		int minCoords[3];
+		std::vector<char> coordTables[3];
+	};
+	
+	// the probability of a point, multiplied by ObservationTable::Multiply
+	// with the overlap of each observation's cell, raised to the number of
+	// observations merged into its constraint
+	struct PointLikelihood {
+		KernelProb prob;
 		int LimitCount;
+		
+		void operator()(int width, int multiplicity) {
+#ifdef using_exact_kernel
+			prob.MultiplyPower(width, multiplicity);
+#else
+			prob*=IntegerPower(width*(KernelFloat)ScaleFactor/LimitCount, multiplicity);
+#endif
+		}
 	};
 	
 	void Normalize();
-	void ComputeProbabilities(ObservedHotspots observedHotspots);
+	void ComputeProbabilities(const ObservationTable &observations);
+	
+	// the kernels, instantiated for the GridScale of each gridRes we run
+	template <class Scale> void ComputeProbabilities(const Scale &scale, const ObservationTable &observations);
+	template <class Scale> Double CalculateHotspotProbability(const Scale &scale, const HotspotCoords &coord, Double prob);
+	template <class Scale> Double CalculateBlockProbability(const Scale &scale, const HotspotCoords &coord, Double prob);
+	template <class Scale> void AccumulateObservations(const Scale &scale, const std::vector<HotspotCoords> &candidates,
+													   const std::vector<AbcdProb> &logProbs, std::vector<ObservationTerms>* terms);
+	void RemoveZeroPoints();
+	
+	void CalculateProbabilityDistribution(const ObservationTable &observations, const AbcdSpaceLimits &limits, int gridRes, int increment,
+										  bool normalize, LikelihoodCache* cache);
+	void CalculateProbabilityDistribution(const ObservationTable &observations, const AbcdSpaceLimitsInt &limits, int gridRes, int increment,
+										  bool normalize, LikelihoodCache* cache);
 	
-	void CalculateProbabilityDistribution(ObservedHotspots observedHotspots, AbcdSpaceLimits limits, int gridRes, int increment, bool normalize = true);
-	void CalculateProbabilityDistribution(ObservedHotspots observedHotspots, AbcdSpaceLimitsInt limits, int gridRes, int increment, bool normalize = true);
-	void static CalculateProbSingleHotspot(HotspotCoordsWithDate coord, void* data);
+	static const Double ScaleFactor;
 	
-	static long int CalculateNumberOfAbcdPoints(AbcdSpaceLimitsInt limsInt, int gridRes, int increment, std::vector<long int>* starts = NULL);
+	static long int CalculateNumberOfAbcdPoints(const AbcdSpaceLimitsInt &limsInt, int gridRes, int increment, std::vector<AbcdSpaceRow>* rows = NULL,
+												long int* numRows = NULL);
 	
-	AbcdSpacePoint* probPoints;
+	std::vector<AbcdSpaceRow> rows;
+	std::vector<Double> rowSums;
+	AbcdProb* probs;
 	long int numProbPoints;
+	long int numGridPoints;
 	int LimitCount;
+	int gridRes;
+	int increment;
 };
 
 
@@ -0,0 +1,376 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include "Backtest.h"
+#include "AbcdSpaceLimits.h"
+#include "ReproducibleSum.h"
+#ifdef using_parallel
+	#include <omp.h>
+#endif
+
+Backtest::Backtest(const ObservedHotspots &observedHotspots, int inGridRes, int inIncrement, bool dedupObserved, int startMonth) {
+	gridRes = inGridRes;
+	increment = inIncrement;
+
+	std::vector<HotspotCoordsWithDate> coords;
+	ObservationCollector collector;
+	collector.observations = &coords;
+	observedHotspots.Visit(collector);
+	std::stable_sort(coords.begin(), coords.end(), CompareDates);
+
+	CompileObservations(coords);
+	startGroup = FindStartGroup(startMonth);
+	PlanGroups(dedupObserved);
+
+	// the grid covers the space allowed by the observations before the
+	// first scored month, which contains that of every later prefix
+	std::vector<HotspotCoordsWithDate> prefix(coords.begin(), coords.begin() + groups[startGroup].begin);
+	ObservedHotspots prefixHotspots(prefix);
+	AbcdSpaceLimits limits(prefixHotspots, false);
+	printf("Backtesting %d months from month %d, with the limits of the %d observations before it.\n",
+		   (int)groups.size() - startGroup, startGroup + 1, (int)prefix.size());
+	fflush(stdout);
+
+	Sweep(limits.GenerateAbcdSpaceLimitsInt(gridRes));
+	printf("Backtest points in the abcd space: %ld.\n", numPoints);
+}
+
+int Backtest::GetNumScored() {
+	int count = 0;
+	for (std::vector<Observation>::iterator it = observations.begin(); it != observations.end(); ++it) {
+		if (it->scored)
+			count++;
+	}
+	return count;
+}
+
+Double Backtest::GetMeanLogLoss() {
+	Double logLoss = 0;
+	for (std::vector<Observation>::iterator it = observations.begin(); it != observations.end(); ++it) {
+		if (it->scored)
+			logLoss -= logl(it->prob);
+	}
+	return logLoss/GetNumScored();
+}
+
+void Backtest::PrintToFile(std::string filename) {
+	FILE* file = fopen(filename.c_str(), "w");
+	if(!file) {
+		printf("Error: Could not open file for writing: \"%s\"\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(file, "Month    moonLat moonLong marsLat marsLong  Probability                                   Log-loss\n");
+	for (unsigned int g = 0; g < groups.size(); g++) {
+		for (int i = groups[g].begin; i < groups[g].end; i++) {
+			const Observation &observation = observations[i];
+			HotspotCoords coord = observation.coord;
+			fprintf(file, "%s-%04d%s", observation.coord.month.ToString().c_str(), observation.coord.year, CoordsToString(coord).c_str());
+			if (observation.scored)
+				fprintf(file, "%46.36Le%14.6Lf\n", observation.prob, -logl(observation.prob));
+			else if ((int)g < startGroup)
+				fprintf(file, "    before the first scored month\n");
+			else
+				fprintf(file, "    repeats an earlier observation\n");
+		}
+	}
+	fprintf(file, "Mean log-loss over %d months: %.6Lf\n", GetNumScored(), GetMeanLogLoss());
+
+	fclose(file);
+
+	printf("Printed backtest scores to file: \"%s\".\n", filename.c_str());
+}
+
+bool Backtest::CompareDates(const HotspotCoordsWithDate &a, const HotspotCoordsWithDate &b) {
+	return GetDate(a) < GetDate(b);
+}
+
+int Backtest::GetDate(const HotspotCoordsWithDate &coord) {
+	return coord.year*12 + coord.month.value;
+}
+
+// as in the input file, with a missing coordinate left blank
+std::string Backtest::CoordsToString(const HotspotCoords &coord) {
+	Coord values[4] = {coord.moonLat, coord.moonLong, coord.marsLat, coord.marsLong};
+	std::string result;
+	for (int j = 0; j < 4; j++) {
+		char buff[16];
+		if (values[j] == HotspotCoords::MissingCoord)
+			sprintf(buff, "%6s", "");
+		else
+			sprintf(buff, "%6d", values[j]);
+		result += buff;
+	}
+	return result;
+}
+
+void Backtest::CompileObservations(const std::vector<HotspotCoordsWithDate> &coords) {
+	int LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*gridRes;
+	int latScale = LimitCount/HotspotCoords::NumLats;
+	int longScale = LimitCount/HotspotCoords::NumLongs;
+
+	for (unsigned int i = 0; i < coords.size(); i++) {
+		const HotspotCoordsWithDate &coord = coords[i];
+		if (coord.moonLat == HotspotCoords::MissingCoord) {
+			printf("Error: coord.moonLat is missing!\n");
+			exit(EXIT_FAILURE);
+		}
+
+		Observation observation;
+		observation.coord = coord;
+		observation.date = GetDate(coord);
+		observation.scored = false;
+		observation.prob = 0;
+		observation.lastDrop = -1;
+
+		int a = coord.moonLat*latScale;
+		Coord values[3] = {coord.moonLong, coord.marsLat, coord.marsLong};
+		int scales[3] = {longScale, latScale, longScale};
+		for (int j = 0; j < 3; j++) {
+			observation.present[j] = values[j] != HotspotCoords::MissingCoord;
+			observation.lows[j] = observation.present[j] ? values[j]*scales[j] - scales[j]/2 - a : 0;
+		}
+		observations.push_back(observation);
+
+		if (groups.empty() || observations[groups.back().begin].date != observation.date) {
+			Group group;
+			group.begin = i;
+			group.end = i;
+			group.rebuild = false;
+			groups.push_back(group);
+		}
+		groups.back().end = i + 1;
+	}
+
+	if (groups.empty()) {
+		printf("Error: No observations to backtest.\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// the observations among the first count that deduplication keeps, in the
+// same way as ObservedHotspots::RemoveDuplicates
+std::vector<int> Backtest::ActiveObservations(int count, bool dedupObserved) {
+	std::vector<bool> keep(count, true);
+	if (dedupObserved) {
+		for (int i = 0; i < count; i++) {
+			for (int j = 0; j < i; j++) {
+				HotspotCoords earlier = observations[j].coord;
+				HotspotCoords later = observations[i].coord;
+				if (earlier.MakesRedundant(later)) {
+					keep[i] = false;
+				} else if (later.MakesRedundant(earlier)) {
+					keep[j] = false;
+				}
+			}
+		}
+	}
+
+	std::vector<int> active;
+	for (int i = 0; i < count; i++) {
+		if (keep[i])
+			active.push_back(i);
+	}
+	return active;
+}
+
+void Backtest::PlanGroups(bool dedupObserved) {
+	std::vector<int> previous;
+	for (unsigned int g = 0; g < groups.size(); g++) {
+		Group &group = groups[g];
+		std::vector<int> active = ActiveObservations(group.begin, dedupObserved);
+
+		std::vector<int> added;
+		std::set_difference(active.begin(), active.end(), previous.begin(), previous.end(), std::back_inserter(added));
+		group.rebuild = active.size() != previous.size() + added.size();
+		if (group.rebuild) {
+			group.factors = active;
+			for (int i = 0; i < group.begin; i++) {
+				if (!std::binary_search(active.begin(), active.end(), i))
+					observations[i].lastDrop = g;
+			}
+		} else {
+			group.factors = added;
+		}
+
+		for (int i = group.begin; i < group.end; i++) {
+			bool repeat = false;
+			for (unsigned int j = 0; j < active.size() && dedupObserved; j++) {
+				HotspotCoords earlier = observations[active[j]].coord;
+				if (earlier.MakesRedundant(observations[i].coord))
+					repeat = true;
+			}
+			observations[i].scored = (int)g >= startGroup && !repeat;
+		}
+
+		previous = active;
+	}
+}
+
+int Backtest::FindStartGroup(int startMonth) {
+	int first = startMonth > 0 ? startMonth - 1 : 1;
+	if (first >= (int)groups.size()) {
+		printf("Error: Backtest start month %d is beyond the last month, %d.\n", first + 1, (int)groups.size());
+		exit(EXIT_FAILURE);
+	}
+
+	for (int g = first; g < (int)groups.size(); g++) {
+		std::vector<HotspotCoordsWithDate> prefix;
+		for (int i = 0; i < groups[g].begin; i++)
+			prefix.push_back(observations[i].coord);
+		ObservedHotspots prefixHotspots(prefix);
+		AbcdSpaceLimits limits(prefixHotspots, false);
+		if (limits.IsBounded())
+			return g;
+
+		if (startMonth > 0) {
+			printf("Error: The observations before backtest start month %d do not bound the abcd space.\n", startMonth);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	printf("Error: The observations never bound the abcd space.\n");
+	exit(EXIT_FAILURE);
+}
+
+void Backtest::Sweep(const AbcdSpaceLimitsInt &limsInt) {
+	int LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*gridRes;
+	int numGroups = groups.size();
+	int numObservations = observations.size();
+	int numColumns = numGroups + numObservations;
+
+	int minBa = LimitCount - limsInt.limits[0][1] + increment;
+	int maxBa = limsInt.limits[1][0];
+	long int numBa = maxBa > minBa ? (maxBa - minBa - 1)/increment + 1 : 0;
+	long int numBlocks = (numBa + BaBlockSize - 1)/BaBlockSize;
+
+	// sums[block*numColumns + g] sums the running products at month g, and
+	// sums[block*numColumns + numGroups + i] those times the factor of i
+	std::vector<Double> sums(numBlocks*numColumns, 0);
+	numPoints = 0;
+	long int points = 0;
+
+	#ifdef using_parallel
+	#pragma omp parallel
+	#endif
+	{
+		std::vector<int> rowMin(numObservations);
+		std::vector<int> rowMax(numObservations);
+		std::vector<int> widths(numObservations);
+
+		#ifdef using_parallel
+		#pragma omp for schedule(dynamic) reduction(+:points)
+		#endif
+		for (long int block = 0; block < numBlocks; block++) {
+			Double* blockSums = &sums[block*numColumns];
+			for (long int k = block*BaBlockSize; k < std::min((block + 1)*BaBlockSize, numBa); k++) {
+				int ba = minBa + k*increment;
+				switch (gridRes) {
+					case 1: points += SweepBa(GridScale<1>(gridRes), limsInt, ba, blockSums, rowMin, rowMax, widths); break;
+					case 5: points += SweepBa(GridScale<5>(gridRes), limsInt, ba, blockSums, rowMin, rowMax, widths); break;
+					case 10: points += SweepBa(GridScale<10>(gridRes), limsInt, ba, blockSums, rowMin, rowMax, widths); break;
+					case 20: points += SweepBa(GridScale<20>(gridRes), limsInt, ba, blockSums, rowMin, rowMax, widths); break;
+					case 50: points += SweepBa(GridScale<50>(gridRes), limsInt, ba, blockSums, rowMin, rowMax, widths); break;
+					case 100: points += SweepBa(GridScale<100>(gridRes), limsInt, ba, blockSums, rowMin, rowMax, widths); break;
+					default: points += SweepBa(GridScale<0>(gridRes), limsInt, ba, blockSums, rowMin, rowMax, widths); break;
+				}
+			}
+		}
+	}
+	numPoints = points;
+
+	int latScale = LimitCount/HotspotCoords::NumLats;
+	for (int g = startGroup; g < numGroups; g++) {
+		Double total = ReproducibleSum(BlockSums(&sums, numColumns, g), numBlocks);
+		for (int i = groups[g].begin; i < groups[g].end; i++) {
+			if (!observations[i].scored)
+				continue;
+			Double weighted = ReproducibleSum(BlockSums(&sums, numColumns, numGroups + i), numBlocks);
+			observations[i].prob = weighted/(total*latScale);
+		}
+	}
+}
+
+// adds the running products of the points with the given ba to sums, and
+// returns the number of points
+template <class Scale>
+long int Backtest::SweepBa(const Scale &scale, const AbcdSpaceLimitsInt &limsInt, int ba, Double* sums,
+						   std::vector<int> &rowMin, std::vector<int> &rowMax, std::vector<int> &widths) {
+	int LimitCount = scale.LimitCount();
+	int latScale = scale.LatScale();
+	int longScale = scale.LongScale();
+	int numGroups = groups.size();
+	int numObservations = observations.size();
+	long int points = 0;
+
+	for (int ca = LimitCount - limsInt.limits[0][2] + increment; ca < limsInt.limits[2][0]; ca += increment) {
+		if (!(ca-ba > LimitCount - limsInt.limits[1][2] && ca-ba < limsInt.limits[2][1]))
+			continue;
+
+		// b & c are fixed along a row, so only the da bounds vary per point
+		for (int i = 0; i < numObservations; i++) {
+			const Observation &observation = observations[i];
+			int xmin = -latScale/2;
+			int xmax = latScale - latScale/2;
+			if (observation.present[0]) {
+				xmin = std::max(xmin, scale.Wrap(observation.lows[0] - ba));
+				xmax = std::min(xmax, scale.Wrap(observation.lows[0] + longScale - ba));
+			}
+			if (observation.present[1]) {
+				xmin = std::max(xmin, scale.Wrap(observation.lows[1] - ca));
+				xmax = std::min(xmax, scale.Wrap(observation.lows[1] + latScale - ca));
+			}
+			rowMin[i] = xmin;
+			rowMax[i] = xmax;
+		}
+
+		for (int da = LimitCount - limsInt.limits[0][3] + increment; da < limsInt.limits[3][0]; da += increment) {
+			if (!(da-ba > LimitCount - limsInt.limits[1][3] && da-ba < limsInt.limits[3][1] &&
+				  da-ca > LimitCount - limsInt.limits[2][3] && da-ca < limsInt.limits[3][2]))
+				continue;
+			points++;
+
+			// a zero product stays zero until a rebuild leaves out every
+			// factor that zeroed it
+			Double product = 1;
+			int zeroUntil = numGroups;
+			for (int g = 0; g < numGroups; g++) {
+				const Group &group = groups[g];
+				if (group.rebuild) {
+					product = 1;
+					zeroUntil = numGroups;
+				}
+				for (std::vector<int>::const_iterator j = group.factors.begin(); j != group.factors.end(); ++j) {
+					product *= widths[*j];
+					if (widths[*j] == 0)
+						zeroUntil = std::min(zeroUntil, observations[*j].lastDrop);
+				}
+				if (g >= zeroUntil)
+					break;
+
+				for (int i = group.begin; i < group.end; i++) {
+					const Observation &observation = observations[i];
+					int xmin = rowMin[i];
+					int xmax = rowMax[i];
+					if (observation.present[2]) {
+						xmin = std::max(xmin, scale.Wrap(observation.lows[2] - da));
+						xmax = std::min(xmax, scale.Wrap(observation.lows[2] + longScale - da));
+					}
+					widths[i] = std::max(0, xmax - xmin);
+				}
+
+				if (g >= startGroup) {
+					sums[g] += product;
+					for (int i = group.begin; i < group.end; i++) {
+						if (observations[i].scored)
+							sums[numGroups + i] += product*widths[i];
+					}
+				}
+			}
+		}
+	}
+
+	return points;
+}
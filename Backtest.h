@@ -0,0 +1,106 @@
+#ifndef __BACKTEST__
+#define __BACKTEST__
+
+
+#include <string>
+#include <vector>
+#include "Common.h"
+#include "ObservedHotspots.h"
+#include "AbcdSpaceLimitsInt.h"
+#include "GridScale.h"
+
+// Scores the model against the observations month by month: for each
+// observed hotspot, the probability the grid model gave its coordinates
+// (given its moon latitude) using only the observations of earlier months.
+// A single sweep of the abcd grid keeps, for every point, the running
+// product of the factors of the observations seen so far, and accumulates
+// per month the sum of the products and of the products times the factor
+// of that month's hotspot.
+class Backtest {
+public:
+	Backtest(const ObservedHotspots &observedHotspots, int gridRes, int increment, bool dedupObserved, int startMonth = 0);
+
+	void PrintToFile(std::string filename);
+
+	int GetNumScored();
+	Double GetMeanLogLoss();
+
+	// consecutive abcd space ba values whose sums are added in order
+	static const int BaBlockSize = 16;
+
+private:
+	struct Observation {
+		HotspotCoordsWithDate coord;
+		int date;
+
+		// lower edge of the moon longitude, mars latitude & mars longitude
+		// cells, relative to the moon latitude, if present
+		bool present[3];
+		int lows[3];
+
+		bool scored;
+		Double prob;
+
+		// the last month whose rebuild leaves it out of the product, or -1,
+		// after which a point it zeroes stays zero
+		int lastDrop;
+	};
+
+	// the observations of one month, and the factors to multiply into the
+	// running product before scoring them: those added since the previous
+	// month or, if deduplication dropped an earlier observation, all of them
+	struct Group {
+		int begin;
+		int end;
+		bool rebuild;
+		std::vector<int> factors;
+	};
+
+	// the sums accumulated over a block of ba values
+	class BlockSums {
+	public:
+		BlockSums(const std::vector<Double>* inSums, int inNumColumns, int inColumn) :
+			sums(inSums), numColumns(inNumColumns), column(inColumn) {}
+
+		Double operator[](long int i) const {
+			return (*sums)[i*numColumns + column];
+		}
+
+	private:
+		const std::vector<Double>* sums;
+		int numColumns;
+		int column;
+	};
+
+	struct ObservationCollector {
+		std::vector<HotspotCoordsWithDate>* observations;
+
+		void operator()(const HotspotCoordsWithDate &coord) {
+			observations->push_back(coord);
+		}
+	};
+
+	static bool CompareDates(const HotspotCoordsWithDate &a, const HotspotCoordsWithDate &b);
+	static int GetDate(const HotspotCoordsWithDate &coord);
+	static std::string CoordsToString(const HotspotCoords &coord);
+
+	void CompileObservations(const std::vector<HotspotCoordsWithDate> &coords);
+	void PlanGroups(bool dedupObserved);
+	std::vector<int> ActiveObservations(int count, bool dedupObserved);
+	int FindStartGroup(int startMonth);
+	void Sweep(const AbcdSpaceLimitsInt &limsInt);
+
+	template <class Scale>
+	long int SweepBa(const Scale &scale, const AbcdSpaceLimitsInt &limsInt, int ba, Double* sums,
+					 std::vector<int> &rowMin, std::vector<int> &rowMax, std::vector<int> &widths);
+
+	std::vector<Observation> observations;
+	std::vector<Group> groups;
+	int startGroup;
+	int gridRes;
+	int increment;
+	long int numPoints;
+};
+
+
+#endif
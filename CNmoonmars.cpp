@@ -8,6 +8,11 @@
 #include "AbcdSpaceProbabilityDistribution.h"
 #include "RegenerateMatrix.h"
 #include "PossibleHotspotsDistribution.h"
+#include "Backtest.h"
+#include "MarginalMaps.h"
+#include "InformationGain.h"
+#include "Manifest.h"
+#include "ThreadPlacement.h"
 #ifdef using_parallel
 	#include <omp.h>
 #endif
@@ -16,10 +21,31 @@ struct Params {
 	int gridRes;
 	int increment;
 	int interval;
+	int memoryBudget;
+	
+	std::string cacheDir;
+	int cacheSize;
+	
+	bool backtest;
+	int backtestStart;
+	
+	int topK;
+	bool marginals;
+	int givenMoonLat;
+	int givenMoonLong;
+	bool lookahead;
 	
 	bool deduplicateObserved;
 	bool outputStatus;
 	
+	bool continuous;
+	int cellOrder;
+	
+	int threads;
+	std::string threadPlaces;
+	std::string threadBind;
+	bool replicateObservations;
+	
 	int startIndex;
 	int endIndex;
 	
@@ -33,6 +59,13 @@ struct Params {
 	std::string possibleHotspotsFile;
 	std::string nonremovableHotspotsFile;
 	std::string nonremovableProbFile;
+	std::string backtestFile;
+	std::string topKFile;
+	std::string moonMarginalFile;
+	std::string marsMarginalFile;
+	std::string conditionalFile;
+	std::string lookaheadFile;
+	std::string manifestFile;
 	
 	std::string statusDir;
 };
@@ -44,10 +77,31 @@ Params DefaultParams() {
 	params.increment = 1;
 	
 	params.interval = 1;
+	params.memoryBudget = 0;
+	
+	params.cacheDir = "";
+	params.cacheSize = 4096;
+	
+	params.backtest = false;
+	params.backtestStart = 0;
+	
+	params.topK = 0;
+	params.marginals = false;
+	params.givenMoonLat = HotspotCoords::MissingCoord;
+	params.givenMoonLong = HotspotCoords::MissingCoord;
+	params.lookahead = false;
 	
 	params.deduplicateObserved = true;
 	params.outputStatus = false;
 	
+	params.continuous = false;
+	params.cellOrder = 4;
+	
+	params.threads = 0;
+	params.threadPlaces = "";
+	params.threadBind = "";
+	params.replicateObservations = false;
+	
 	params.startIndex = 0;
 	params.endIndex = 0;
 	
@@ -61,6 +115,13 @@ Params DefaultParams() {
 	params.possibleHotspotsFile = "possiblehotspots.txt";
 	params.nonremovableHotspotsFile = "possiblehotspots-nonremovable.txt";
 	params.nonremovableProbFile = "nonremovable-prob.txt";
+	params.backtestFile = "backtest.txt";
+	params.topKFile = "tophotspots.txt";
+	params.moonMarginalFile = "moonmarginal.txt";
+	params.marsMarginalFile = "marsmarginal.txt";
+	params.conditionalFile = "conditionalmars.txt";
+	params.lookaheadFile = "lookahead.txt";
+	params.manifestFile = "manifest.txt";
 	
 	params.statusDir = "status/";
 	
@@ -105,6 +166,29 @@ void ParseArguments(int argc, char* argv[], Params &params) {
 		{"mFile",						required_argument, NULL, 137},
 		{"deduplicateObserved",			required_argument, NULL, 138},
 		{"outputStatus",				required_argument, NULL, 139},
+		{"continuous",					required_argument, NULL, 140},
+		{"cellOrder",					required_argument, NULL, 141},
+		{"memoryBudget",				required_argument, NULL, 142},
+		{"cacheDir",					required_argument, NULL, 143},
+		{"cacheSize",					required_argument, NULL, 144},
+		{"backtest",					required_argument, NULL, 145},
+		{"backtestFile",				required_argument, NULL, 146},
+		{"backtestStart",				required_argument, NULL, 147},
+		{"topK",						required_argument, NULL, 148},
+		{"topKFile",					required_argument, NULL, 149},
+		{"marginals",					required_argument, NULL, 150},
+		{"moonMarginalFile",			required_argument, NULL, 151},
+		{"marsMarginalFile",			required_argument, NULL, 152},
+		{"givenMoonLat",				required_argument, NULL, 153},
+		{"givenMoonLong",				required_argument, NULL, 154},
+		{"conditionalFile",				required_argument, NULL, 155},
+		{"manifestFile",				required_argument, NULL, 156},
+		{"threads",						required_argument, NULL, 157},
+		{"places",						required_argument, NULL, 158},
+		{"bind",						required_argument, NULL, 159},
+		{"replicateObservations",		required_argument, NULL, 160},
+		{"lookahead",					required_argument, NULL, 161},
+		{"lookaheadFile",				required_argument, NULL, 162},
 		{0, 0, 0, 0}
 	};
 	
@@ -130,6 +214,29 @@ void ParseArguments(int argc, char* argv[], Params &params) {
 			case 137: params.mFile = optarg; break;
 			case 138: params.deduplicateObserved = ReadBooleanArgument(optarg, "deduplicateObserved"); break;
 			case 139: params.outputStatus = ReadBooleanArgument(optarg, "outputStatus"); break;
+			case 140: params.continuous = ReadBooleanArgument(optarg, "continuous"); break;
+			case 141: params.cellOrder = atoi(optarg); break;
+			case 142: params.memoryBudget = atoi(optarg); break;
+			case 143: params.cacheDir = optarg; break;
+			case 144: params.cacheSize = atoi(optarg); break;
+			case 145: params.backtest = ReadBooleanArgument(optarg, "backtest"); break;
+			case 146: params.backtestFile = optarg; break;
+			case 147: params.backtestStart = atoi(optarg); break;
+			case 148: params.topK = atoi(optarg); break;
+			case 149: params.topKFile = optarg; break;
+			case 150: params.marginals = ReadBooleanArgument(optarg, "marginals"); break;
+			case 151: params.moonMarginalFile = optarg; break;
+			case 152: params.marsMarginalFile = optarg; break;
+			case 153: params.givenMoonLat = atoi(optarg); break;
+			case 154: params.givenMoonLong = atoi(optarg); break;
+			case 155: params.conditionalFile = optarg; break;
+			case 156: params.manifestFile = optarg; break;
+			case 157: params.threads = atoi(optarg); break;
+			case 158: params.threadPlaces = optarg; break;
+			case 159: params.threadBind = optarg; break;
+			case 160: params.replicateObservations = ReadBooleanArgument(optarg, "replicateObservations"); break;
+			case 161: params.lookahead = ReadBooleanArgument(optarg, "lookahead"); break;
+			case 162: params.lookaheadFile = optarg; break;
 			default: 
 				printf("Error: Could not parse arguments.\n");
 				exit(EXIT_FAILURE);
@@ -141,6 +248,8 @@ void StandardizeDirectoryNames(Params &params) {
 	StandardizeDirectoryName(params.dataDir);
 	StandardizeDirectoryName(params.outputDir);
 	StandardizeDirectoryName(params.statusDir);
+	if(params.cacheDir != "")
+		StandardizeDirectoryName(params.cacheDir);
 }
 
 void MakeDirectory(std::string dirName) {
@@ -170,8 +279,37 @@ void AddPartialSubdirToPath(std::string &dirName, int start, int end) {
 	dirName = buff;
 }
 
-void PrintCoord(HotspotCoordsWithDate coord, void* data) {
-	printf("%s\n", coord.ToString().c_str());
+struct CoordPrinter {
+	void operator()(const HotspotCoordsWithDate &coord) {
+		printf("%s\n", coord.ToString().c_str());
+	}
+};
+
+void WriteManifest(const Params &params, const PossibleHotspotsDistribution &possibleHotspots, bool hasMfile, bool isPartial) {
+	Manifest manifest;
+	manifest.SetParameter("gridRes", params.continuous ? 0 : params.gridRes);
+	manifest.SetParameter("increment", params.increment);
+	manifest.SetParameter("interval", params.interval);
+	manifest.SetParameter("memoryBudget", params.memoryBudget);
+	manifest.SetParameter("deduplicateObserved", params.deduplicateObserved ? "true" : "false");
+	manifest.SetParameter("continuous", params.continuous ? "true" : "false");
+	manifest.SetParameter("cellOrder", params.cellOrder);
+	manifest.SetParameter("startIndex", params.startIndex);
+	manifest.SetParameter("endIndex", params.endIndex);
+	manifest.SetHotspots(possibleHotspots.GetHotspots());
+	
+	manifest.AddFile(params.outputDir, params.inputFile);
+	manifest.AddFile(params.outputDir, params.limitsFile);
+	manifest.AddFile(params.outputDir, params.abcdDistFile);
+	if(hasMfile)
+		manifest.AddFile(params.outputDir, params.mFile);
+	manifest.AddFile(params.outputDir, params.possibleHotspotsFile);
+	if(!isPartial) {
+		manifest.AddFile(params.outputDir, params.nonremovableHotspotsFile);
+		manifest.AddFile(params.outputDir, params.nonremovableProbFile);
+	}
+	
+	manifest.PrintToFile(params.outputDir + params.manifestFile);
 }
 
 int main(int argc, char* argv[]) {
@@ -179,26 +317,46 @@ int main(int argc, char* argv[]) {
 	ParseArguments(argc, argv, params);
 	PossibleHotspotsDistribution::ValidateIndexLimits(params.startIndex, params.endIndex);
 	StandardizeDirectoryNames(params);
+	ConfigureThreads(params.threads, params.threadPlaces, params.threadBind, argv);
+	ObservationTable::SetReplicatePerSocket(params.replicateObservations);
 	
 	printf("===============================================================\n");
 	
 #ifdef using_parallel
 	printf("Number of cores:                %4d\n", omp_get_num_procs());
-	printf("Max number of OpenMP threads:   %4d\n\n", omp_get_max_threads());
+	printf("Max number of OpenMP threads:   %4d\n", omp_get_max_threads());
 #endif
+	PrintThreadPlacement();
+	if(params.replicateObservations)
+		printf("Observations replicated on each socket.\n");
+	printf("\n");
 	
-	printf("Grid resolution:                %4d\n", params.gridRes);
-	printf("Grid increment:                 %4d\n", params.increment);
-	printf("Abcd space chunking interval:   %4d\n\n", params.interval);
+	if(params.continuous) {
+		printf("Continuous abcd space cells:    %4d\n", AbcdSpaceContinuousDistribution::CellRes);
+		printf("Cell quadrature order:          %4d\n", params.cellOrder);
+	} else {
+		printf("Grid resolution:                %4d\n", params.gridRes);
+		printf("Grid increment:                 %4d\n", params.increment);
+	}
+	if(params.memoryBudget > 0 && !params.continuous)
+		printf("Abcd space memory budget (MB):  %4d\n\n", params.memoryBudget);
+	else
+		printf("Abcd space chunking interval:   %4d\n\n", params.interval);
+	if(params.cacheDir != "" && !params.continuous) {
+		printf("Likelihood cache directory is \"%s\".\n", params.cacheDir.c_str());
+		printf("Likelihood cache size (MB):     %4d\n\n", params.cacheSize);
+	}
 	
 	std::string infile = params.dataDir + params.inputFile;
 	printf("Input file is \"%s\".\n", infile.c_str());
 	
+	// the backtest deduplicates the observations before each month itself
 	ObservedHotspots observedHotspots(infile);
-	if(params.deduplicateObserved){
+	if(params.deduplicateObserved && !params.backtest){
 		observedHotspots.RemoveDuplicates();
 	}
-	observedHotspots.Iterate(PrintCoord, NULL);
+	CoordPrinter printer;
+	observedHotspots.Visit(printer);
 	printf("\n");
 	
 	AbcdSpaceLimits limits(observedHotspots);
@@ -233,7 +391,88 @@ int main(int argc, char* argv[]) {
 	limits.PrintToFile(params.outputDir + params.limitsFile);
 	printf("\n");
 	
-	AbcdSpaceProbabilityDistribution abcdDist(observedHotspots, limits, 1, 5);
+	if(params.backtest) {
+		Backtest backtest(observedHotspots, params.gridRes, params.increment, params.deduplicateObserved, params.backtestStart);
+		backtest.PrintToFile(params.outputDir + params.backtestFile);
+		printf("\nMean log-loss over %d months:\n", backtest.GetNumScored());
+		printf("%.6Lf\n", backtest.GetMeanLogLoss());
+		return EXIT_SUCCESS;
+	}
+	
+	LikelihoodCache* cache = NULL;
+	if(params.cacheDir != "") {
+		MakeDirectoryRecursive(params.cacheDir);
+		cache = new LikelihoodCache(params.cacheDir, (long int)params.cacheSize*1024*1024);
+	}
+	
+	if(params.topK > 0) {
+		if(isPartial || params.continuous) {
+			printf("Error: The top hotspots are found on the grid, from a single full run.\n");
+			exit(EXIT_FAILURE);
+		}
+		
+		RegenerateMatrix* regenMat = NULL;
+		std::string inMfile = params.dataDir + params.mFile;
+		if(std::ifstream(inMfile.c_str())) {
+			regenMat = new RegenerateMatrix(inMfile);
+			printf("\n");
+		}
+		
+		printf("Finding the %d most probable hotspots:\n", params.topK);
+		PossibleHotspotsDistribution topHotspots(observedHotspots, limits, regenMat, cache, params.gridRes, params.increment, params.interval,
+												 params.memoryBudget, params.topK);
+		topHotspots.PrintRankingToFile(params.outputDir + params.topKFile);
+		return EXIT_SUCCESS;
+	}
+	
+	if(params.marginals) {
+		if(isPartial || params.continuous) {
+			printf("Error: The marginals are found on the grid, from a single full run.\n");
+			exit(EXIT_FAILURE);
+		}
+		
+		printf("Finding the moon & mars marginals:\n");
+		MarginalMaps marginals(observedHotspots, limits, cache, params.gridRes, params.increment, params.interval, params.memoryBudget);
+		marginals.PrintMoonToFile(params.outputDir + params.moonMarginalFile);
+		marginals.PrintMarsToFile(params.outputDir + params.marsMarginalFile);
+		return EXIT_SUCCESS;
+	}
+	
+	bool conditional = params.givenMoonLat != HotspotCoords::MissingCoord || params.givenMoonLong != HotspotCoords::MissingCoord;
+	if(conditional) {
+		if(isPartial || params.continuous) {
+			printf("Error: The conditional mars map is found on the grid, from a single full run.\n");
+			exit(EXIT_FAILURE);
+		}
+		if(params.givenMoonLat == HotspotCoords::MissingCoord || params.givenMoonLong == HotspotCoords::MissingCoord) {
+			printf("Error: Both the moon latitude & longitude must be given.\n");
+			exit(EXIT_FAILURE);
+		}
+		
+		HotspotCoords givenMoon;
+		givenMoon.moonLat = params.givenMoonLat;
+		givenMoon.moonLong = params.givenMoonLong;
+		printf("Finding the mars marginal given the moon at (%d, %d):\n", givenMoon.moonLat, givenMoon.moonLong);
+		MarginalMaps marginals(observedHotspots, limits, cache, params.gridRes, params.increment, params.interval, params.memoryBudget,
+							   givenMoon);
+		marginals.PrintMarsToFile(params.outputDir + params.conditionalFile);
+		return EXIT_SUCCESS;
+	}
+	
+	if(params.lookahead) {
+		if(isPartial || params.continuous) {
+			printf("Error: The lookahead is found on the grid, from a single full run.\n");
+			exit(EXIT_FAILURE);
+		}
+		
+		printf("Finding the information each possible hotspot would give if observed next:\n");
+		InformationGain lookahead(observedHotspots, limits, cache, params.gridRes, params.increment, params.interval, params.memoryBudget);
+		lookahead.PrintToFile(params.outputDir + params.lookaheadFile);
+		return EXIT_SUCCESS;
+	}
+	
+	ObservationTable observations(observedHotspots, limits.GenerateAbcdSpaceLimitsInt(1), 1);
+	AbcdSpaceProbabilityDistribution abcdDist(observations, limits, 1, 5, true, cache);
 	abcdDist.PrintToFile(params.outputDir + params.abcdDistFile);
 	printf("\n");
 	
@@ -258,8 +497,9 @@ int main(int argc, char* argv[]) {
 	else
 		statusFullDir = "/dev/null";
 	
-	PossibleHotspotsDistribution possibleHotspots(observedHotspots, limits, regenMat, params.gridRes, params.increment, params.interval,
-												  params.deduplicateObserved, statusFullDir, params.startIndex, params.endIndex);
+	PossibleHotspotsDistribution possibleHotspots(observedHotspots, limits, regenMat, cache, params.gridRes, params.increment, params.interval,
+												  params.memoryBudget, params.deduplicateObserved, params.continuous, params.cellOrder, statusFullDir, 
+												  params.startIndex, params.endIndex);
 	possibleHotspots.PrintToFile(params.outputDir + params.possibleHotspotsFile);
 	
 	if(!isPartial) {
@@ -289,5 +529,9 @@ int main(int argc, char* argv[]) {
 		printf("%.36Lg%%\n", 100*(1-accumProb));
 	}
 	
+	// written last, so that it also marks the run as complete
+	printf("\n");
+	WriteManifest(params, possibleHotspots, regenMat != NULL, isPartial);
+	
 	return EXIT_SUCCESS;
 }
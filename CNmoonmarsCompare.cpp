@@ -0,0 +1,51 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "Common.h"
+#include "HotspotCoordsWithProbability.h"
+#include "HotspotComparison.h"
+
+std::vector<HotspotCoordsWithProbability> ReadPossibleHotspotsFile(std::string filename) {
+	FILE* file = fopen(filename.c_str(), "r");
+	if(file == NULL) {
+		printf("Error: Could not open file \"%s\".\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<HotspotCoordsWithProbability> points;
+	HotspotCoordsWithProbability newCoord;
+	while(fscanf(file, "%6hd%6hd%6hd%6hd%46Le\n", &(newCoord.moonLat), &(newCoord.moonLong),
+				 &(newCoord.marsLat), &(newCoord.marsLong), &(newCoord.prob)) == 5) {
+		points.push_back(newCoord);
+	}
+
+	if(!feof(file)) {
+		printf("Error: Could not read line %d of \"%s\".\n", (int)points.size() + 1, filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	fclose(file);
+
+	return points;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc != 3) {
+		printf("Usage: ./CNmoonmarsCompare referenceFile testFile\n");
+		return EXIT_FAILURE;
+	}
+
+	std::vector<HotspotCoordsWithProbability> refPoints = ReadPossibleHotspotsFile(argv[1]);
+	std::vector<HotspotCoordsWithProbability> testPoints = ReadPossibleHotspotsFile(argv[2]);
+
+	printf("===============================================================\n");
+	printf("Reference file: \"%s\"\n", argv[1]);
+	printf("Test file:      \"%s\"\n\n", argv[2]);
+
+	HotspotComparison comparison(refPoints, testPoints);
+	if (!comparison.CoordinatesMatch())
+		return EXIT_FAILURE;
+	comparison.Print(testPoints);
+
+	return EXIT_SUCCESS;
+}
@@ -1,40 +1,373 @@
 #include <cstdio>
 #include <cstdlib>
+#include <cctype>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <getopt.h>
+#include <sys/time.h>
 #include "Common.h"
 #include "ObservedHotspots.h"
 #include "AbcdSpaceLimits.h"
 #include "AbcdSpaceProbabilityDistribution.h"
+#include "PossibleHotspotsDistribution.h"
+#include "ObservationTable.h"
+#include "RegenerateMatrix.h"
+#include "PackedHotspots.h"
+
+#ifdef using_parallel
+#include <omp.h>
+#endif
+
+// Plans a grid run before it is started.  A short measured run at a low
+// resolution calibrates the cost of computing one abcd space point and of
+// adding one point to one hotspot on this machine, from which the wall time
+// of a run is predicted: every worker computes the whole abcd space, and
+// adds it to the hotspots of its own index range that the M file requires.
+// The peak memory of each chunking interval is predicted from the slabs of
+// the abcd space, the index ranges of the workers are balanced by the
+// number of required hotspots in them, and with a deadline the highest
+// resolution predicted to finish in time is chosen.
+
+struct Params {
+	int gridRes;
+	int increment;
+	int workers;
+	int memoryBudget;
+	int deadline;
+	int calibrationRes;
+	bool deduplicateObserved;
+
+	std::string dataDir;
+	std::string inputFile;
+	std::string mFile;
+};
+
+Params DefaultParams() {
+	Params params;
+
+	params.gridRes = 5;
+	params.increment = 1;
+	params.workers = 1;
+	params.memoryBudget = 4096;
+	params.deadline = 0;
+	params.calibrationRes = 2;
+	params.deduplicateObserved = true;
+
+	params.dataDir = "data/";
+	params.inputFile = "input-observedhotspots.txt";
+	params.mFile = "M.txt";
+
+	return params;
+}
+
+// the resolutions the deadline mode chooses from
+static const int DeadlineGridRes[] = {1, 2, 5, 10, 20, 50, 100};
+
+struct Costs {
+	// seconds of wall time per abcd space point, and per point & hotspot
+	double perPoint;
+	double perPointHotspot;
+};
+
+struct Plan {
+	long int numPoints;
+	int interval;
+	int numChunks;
+	long int peakMemory;
+	bool fitsBudget;
+	double time;
+};
+
+bool ReadBooleanArgument(char* argument, std::string argName){
+	std::string argVal = argument;
+	for(unsigned int i=0; i < argVal.size(); i++) {
+		argVal[i]=tolower(argVal[i]);
+	}
+
+	if(argVal == "false" || argVal == "f" || argVal == "0") {
+		return false;
+	}
+
+	if(argVal == "true" || argVal == "t" || argVal == "1") {
+		return true;
+	}
+
+	printf("Error: Invalid value for argument %s: \"%s\".\n", argName.c_str(), argument);
+	exit(EXIT_FAILURE);
+}
+
+void ParseArguments(int argc, char* argv[], Params &params) {
+	static struct option long_options[] =
+	{
+		{"gridRes",						required_argument, NULL, 'g'},
+		{"increment",					required_argument, NULL, 'c'},
+		{"workers",						required_argument, NULL, 'w'},
+		{"memoryBudget",				required_argument, NULL, 'm'},
+		{"deadline",					required_argument, NULL, 'd'},
+		{"calibrationRes",				required_argument, NULL, 'r'},
+		{"dataDir",						required_argument, NULL, 128},
+		{"inputFile",					required_argument, NULL, 131},
+		{"mFile",						required_argument, NULL, 137},
+		{"deduplicateObserved",			required_argument, NULL, 138},
+		{0, 0, 0, 0}
+	};
+
+	int option_index;
+	int c;
+	while ((c = getopt_long_only(argc, argv, "", long_options, &option_index)) != -1) {
+		switch (c)
+		{
+			case 'g': params.gridRes = atoi(optarg); break;
+			case 'c': params.increment = atoi(optarg); break;
+			case 'w': params.workers = atoi(optarg); break;
+			case 'm': params.memoryBudget = atoi(optarg); break;
+			case 'd': params.deadline = atoi(optarg); break;
+			case 'r': params.calibrationRes = atoi(optarg); break;
+			case 128: params.dataDir = optarg; break;
+			case 131: params.inputFile = optarg; break;
+			case 137: params.mFile = optarg; break;
+			case 138: params.deduplicateObserved = ReadBooleanArgument(optarg, "deduplicateObserved"); break;
+			default:
+				printf("Error: Could not parse arguments.\n");
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	// the original form, "gridRes increment", is still accepted
+	if (argc - optind == 2) {
+		params.gridRes = atoi(argv[optind]);
+		params.increment = atoi(argv[optind + 1]);
+	} else if (argc != optind) {
+		printf("Usage: ./CNmoonmarsCountPoints [gridRes increment] [-gridRes n] [-increment n] [-workers n] [-memoryBudget MB]\n"
+			   "                               [-deadline seconds] [-calibrationRes n] [-dataDir dir] [-inputFile file] [-mFile file]\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (params.gridRes < 1 || params.increment < 1 || params.workers < 1 || params.memoryBudget < 1 ||
+		params.deadline < 0 || params.calibrationRes < 1) {
+		printf("Error: Invalid arguments.\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+double WallTime() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+// which hotspots a run computes, by position; all of them without an M file
+std::vector<bool> RequiredHotspots(const std::vector<HotspotCoordsWithProbability> &hotspots, RegenerateMatrix* regenMat) {
+	std::vector<bool> required(hotspots.size(), true);
+	if (regenMat == NULL)
+		return required;
+
+	regenMat->MatchHotspots(hotspots);
+	for (unsigned int i = 0; i < hotspots.size(); i++)
+		required[i] = regenMat->IsRequired(i);
+	return required;
+}
+
+// times the abcd space of a low resolution, & adding it to a sample of the
+// required hotspots
+Costs Calibrate(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits,
+				const std::vector<HotspotCoordsWithProbability> &hotspots, const std::vector<bool> &required, int gridRes) {
+	std::vector<HotspotCoordsWithProbability> sample;
+	for (unsigned int i = 0; i < hotspots.size(); i++) {
+		if (required[i])
+			sample.push_back(hotspots[i]);
+	}
+
+	const unsigned int MaxSample = 64;
+	if (sample.size() > MaxSample) {
+		std::vector<HotspotCoordsWithProbability> spread;
+		for (unsigned int i = 0; i < MaxSample; i++)
+			spread.push_back(sample[(long int)i*sample.size()/MaxSample]);
+		sample = spread;
+	}
+
+	double start = WallTime();
+	ObservationTable observations(observedHotspots, limits.GenerateAbcdSpaceLimitsInt(gridRes), gridRes);
+	AbcdSpaceProbabilityDistribution abcdDistribution(observations, limits, gridRes, 1, false);
+	double kernelTime = WallTime() - start;
+
+	start = WallTime();
+	#ifdef using_parallel
+	#pragma omp parallel for
+	#endif
+	for (int i = 0; i < (int)sample.size(); i++)
+		sample[i].prob = abcdDistribution.CalculateHotspotProbability(sample[i], 0);
+	double accumulateTime = WallTime() - start;
+
+	long int numPoints = std::max(abcdDistribution.GetNumPoints(), 1L);
+	printf("Calibrated at gridRes = %d, increment = 1 on %ld points and %d hotspots:\n",
+		   gridRes, abcdDistribution.GetNumPoints(), (int)sample.size());
+	printf("  %.2f s for the abcd space, %.2f s to add it to the hotspots.\n\n", kernelTime, accumulateTime);
+
+	Costs costs;
+	costs.perPoint = kernelTime/numPoints;
+	costs.perPointHotspot = sample.empty() ? 0 : accumulateTime/numPoints/sample.size();
+	return costs;
+}
+
+// index ranges, 1-based & inclusive, holding equal numbers of required
+// hotspots; fewer than numWorkers when there are too few to share
+void BalanceRanges(const std::vector<bool> &required, int numWorkers, std::vector<int>* starts, std::vector<int>* ends) {
+	long int total = 0;
+	for (unsigned int i = 0; i < required.size(); i++)
+		total += required[i];
+
+	int worker = 0;
+	long int count = 0;
+	starts->push_back(1);
+	for (unsigned int i = 0; i < required.size(); i++) {
+		count += required[i];
+		if (worker < numWorkers - 1 && i + 1 < required.size() && count*numWorkers >= (worker + 1)*total) {
+			ends->push_back(i + 1);
+			starts->push_back(i + 2);
+			// a hotspot crossing several shares still ends just one range
+			while (worker < numWorkers - 1 && count*numWorkers >= (worker + 1)*total)
+				worker++;
+		}
+	}
+	ends->push_back(required.size());
+}
+
+// the largest interval whose chunks all fit in the budget, & their peak
+void ChooseInterval(const AbcdSpaceLimits &limits, int gridRes, int increment, long int budget, Plan* plan) {
+	AbcdSpaceLimitsInt limsInt = limits.GenerateAbcdSpaceLimitsInt(gridRes);
+	std::vector<AbcdSpaceLimitsInt> slabs;
+	PossibleHotspotsDistribution::PlanChunks(limsInt, gridRes, increment, 1, 0, &slabs);
+
+	std::vector<long int> slabSizes;
+	for (std::vector<AbcdSpaceLimitsInt>::iterator slab = slabs.begin(); slab < slabs.end(); slab++)
+		slabSizes.push_back(AbcdSpaceProbabilityDistribution::CalculateMemoryUsage(*slab, gridRes, increment));
+
+	int numSlabs = slabSizes.size();
+	plan->interval = 1;
+	plan->peakMemory = 0;
+	for (int interval = std::max(numSlabs, 1); interval >= 1; interval--) {
+		long int peak = 0;
+		for (int first = 0; first < numSlabs; first += interval) {
+			long int size = 0;
+			for (int i = first; i < std::min(first + interval, numSlabs); i++)
+				size += slabSizes[i];
+			peak = std::max(peak, size);
+		}
+
+		plan->interval = interval;
+		plan->peakMemory = peak;
+		if (peak <= budget)
+			break;
+	}
+	plan->numChunks = numSlabs > 0 ? (numSlabs + plan->interval - 1)/plan->interval : 0;
+	plan->fitsBudget = plan->peakMemory <= budget;
+}
+
+Plan PlanRun(const AbcdSpaceLimits &limits, const Costs &costs, int gridRes, int increment, int maxRequired,
+			 long int hotspotsMemory, long int budget) {
+	Plan plan;
+	plan.numPoints = AbcdSpaceProbabilityDistribution::CalculateNumberOfAbcdPoints(limits, gridRes, increment);
+	ChooseInterval(limits, gridRes, increment, budget - hotspotsMemory, &plan);
+	plan.peakMemory += hotspotsMemory;
+	plan.time = plan.numPoints*(costs.perPoint + maxRequired*costs.perPointHotspot);
+	return plan;
+}
 
 int main(int argc, char* argv[]) {
-	int gridRes = 5;
-	int increment = 1;
-	
-	if (argc != 3) {
-		printf("Usage: ./CNmoonmarsCountPoints gridRes increment\n");
-		return EXIT_FAILURE;
-	}
-	
-	gridRes = atoi(argv[1]);
-	increment = atoi(argv[2]);
-	
+	Params params = DefaultParams();
+	ParseArguments(argc, argv, params);
+	StandardizeDirectoryName(params.dataDir);
+
 	printf("===============================================================\n");
-	
-	std::string inputFile = "data/input-observedhotspots.txt";
-	
+
+#ifdef using_parallel
+	printf("Max number of OpenMP threads:   %4d\n\n", omp_get_max_threads());
+#endif
+
+	std::string inputFile = params.dataDir + params.inputFile;
+
 	printf("Point count is based on observed hotspots in file:\n");
 	printf("%s\n\n", inputFile.c_str());
-	
+
 	ObservedHotspots observedHotspots(inputFile);
-	//observedHotspots.Iterate(PrintCoord, NULL);
-	//printf("\n");
-	
+	if (params.deduplicateObserved)
+		observedHotspots.RemoveDuplicates();
+
 	AbcdSpaceLimits limits(observedHotspots);
 	limits.PrintToFile(stdout);
 	printf("\n");
-	
-	long int count = AbcdSpaceProbabilityDistribution::CalculateNumberOfAbcdPoints(limits, gridRes, increment);
-	printf("Point count with gridRes = %d, increment = %d:  %ld\n", gridRes, increment, count);
-	
+
+	PossibleHotspotsDistribution possibleHotspots(limits, false);
+	std::vector<HotspotCoordsWithProbability> hotspots = possibleHotspots.GetHotspots().ToVector();
+
+	RegenerateMatrix* regenMat = NULL;
+	std::string mFile = params.dataDir + params.mFile;
+	FILE* file = fopen(mFile.c_str(), "r");
+	if (file) {
+		fclose(file);
+		regenMat = new RegenerateMatrix(mFile);
+	}
+	std::vector<bool> required = RequiredHotspots(hotspots, regenMat);
+	delete regenMat;
+
+	std::vector<int> starts, ends;
+	BalanceRanges(required, params.workers, &starts, &ends);
+	int maxRequired = 0;
+	std::vector<int> rangeRequired;
+	for (unsigned int j = 0; j < starts.size(); j++) {
+		int count = 0;
+		for (int i = starts[j] - 1; i < ends[j]; i++)
+			count += required[i];
+		rangeRequired.push_back(count);
+		maxRequired = std::max(maxRequired, count);
+	}
+	printf("Possible hotspots: %d, of which %d are computed.\n\n", (int)hotspots.size(),
+		   (int)std::count(required.begin(), required.end(), true));
+
+	Costs costs = Calibrate(observedHotspots, limits, hotspots, required, params.calibrationRes);
+
+	long int budget = (long int)params.memoryBudget*1024*1024;
+	// as a run packs them
+	long int hotspotsMemory = hotspots.size()*PackedHotspots::HotspotBytes();
+
+	if (params.deadline > 0) {
+		printf("Resolutions predicted for a deadline of %d s with %d worker(s):\n", params.deadline, (int)starts.size());
+		int chosen = 0;
+		for (unsigned int i = 0; i < sizeof(DeadlineGridRes)/sizeof(DeadlineGridRes[0]); i++) {
+			int gridRes = DeadlineGridRes[i];
+			Plan plan = PlanRun(limits, costs, gridRes, params.increment, maxRequired, hotspotsMemory, budget);
+			printf("  gridRes = %3d:  %14ld points, %12.1f s%s\n", gridRes, plan.numPoints, plan.time,
+				   plan.fitsBudget ? "" : "  (does not fit the memory budget)");
+			if (plan.time > params.deadline)
+				break;
+			if (plan.fitsBudget)
+				chosen = gridRes;
+		}
+		printf("\n");
+
+		if (chosen == 0) {
+			printf("No resolution is predicted to finish within %d s & fit the memory budget.\n", params.deadline);
+			return EXIT_FAILURE;
+		}
+		params.gridRes = chosen;
+	}
+
+	Plan plan = PlanRun(limits, costs, params.gridRes, params.increment, maxRequired, hotspotsMemory, budget);
+
+	printf("Point count with gridRes = %d, increment = %d:  %ld\n\n", params.gridRes, params.increment, plan.numPoints);
+	printf("Predicted wall time:            %.1f s\n", plan.time);
+	printf("Chunking interval:              %4d (%d chunks)\n", plan.interval, plan.numChunks);
+	printf("Predicted peak memory (MB):     %.1f of %d\n", plan.peakMemory/(1024.0*1024.0), params.memoryBudget);
+	if (!plan.fitsBudget)
+		printf("A single ba slab does not fit the budget, so use -memoryBudget %d instead of -interval.\n", params.memoryBudget);
+
+	if (starts.size() > 1) {
+		printf("\nIndex ranges of the workers:\n");
+		for (unsigned int j = 0; j < starts.size(); j++)
+			printf("  -startIndex %d -endIndex %d    (%d computed hotspots)\n", starts[j], ends[j], rangeRequired[j]);
+	}
+
 	return EXIT_SUCCESS;
 }
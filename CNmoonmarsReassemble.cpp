@@ -1,13 +1,23 @@
 #include <cstdlib>
 #include <cstring>
+#include <cctype>
 #include <fstream>
 #include <string>
 #include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <ctime>
 #include <getopt.h>
 #include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "Common.h"
 #include "HotspotCoordsWithProbability.h"
 #include "PossibleHotspotsDistribution.h"
+#include "HotspotIndex.h"
+#include "Manifest.h"
+#include "Sha256.h"
 
 struct PartialFile {
 	std::string directory;
@@ -32,6 +42,11 @@ struct Params {
 	std::string possibleHotspotsFile;
 	std::string nonremovableHotspotsFile;
 	std::string nonremovableProbFile;
+	std::string manifestFile;
+	
+	bool watch;
+	int pollInterval;
+	int timeout;
 };
 
 Params DefaultParams() {
@@ -46,10 +61,33 @@ Params DefaultParams() {
 	params.possibleHotspotsFile = "possiblehotspots.txt";
 	params.nonremovableHotspotsFile = "possiblehotspots-nonremovable.txt";
 	params.nonremovableProbFile = "nonremovable-prob.txt";
+	params.manifestFile = "manifest.txt";
+	
+	params.watch = false;
+	params.pollInterval = 10;
+	params.timeout = 0;
 	
 	return params;
 }
 
+bool ReadBooleanArgument(char* argument, std::string argName){
+	std::string argVal = argument;
+	for(unsigned int i=0; i < argVal.size(); i++) {
+		argVal[i]=tolower(argVal[i]);
+	}
+	
+	if(argVal == "false" || argVal == "f" || argVal == "0") {
+		return false;
+	}
+	
+	if(argVal == "true" || argVal == "t" || argVal == "1") {
+		return true;
+	}
+	
+	printf("Error: Invalid value for argument %s: \"%s\".\n", argName.c_str(), argument);
+	exit(EXIT_FAILURE);
+}
+
 void ParseArguments(int argc, char* argv[], Params &params) {
 	static struct option long_options[] =
 	{
@@ -61,6 +99,10 @@ void ParseArguments(int argc, char* argv[], Params &params) {
 		{"nonremovableHotspotsFile",	required_argument, NULL, 135},
 		{"nonremovableProbFile",		required_argument, NULL, 136},
 		{"mFile",						required_argument, NULL, 137},
+		{"manifestFile",				required_argument, NULL, 138},
+		{"watch",						required_argument, NULL, 139},
+		{"pollInterval",				required_argument, NULL, 140},
+		{"timeout",						required_argument, NULL, 141},
 		{0, 0, 0, 0}
 	};
 	
@@ -77,6 +119,10 @@ void ParseArguments(int argc, char* argv[], Params &params) {
 			case 135: params.nonremovableHotspotsFile = optarg; break;
 			case 136: params.nonremovableProbFile = optarg; break;
 			case 137: params.mFile= optarg; break;
+			case 138: params.manifestFile = optarg; break;
+			case 139: params.watch = ReadBooleanArgument(optarg, "watch"); break;
+			case 140: params.pollInterval = atoi(optarg); break;
+			case 141: params.timeout = atoi(optarg); break;
 			default: 
 				printf("Error: Could not parse arguments.\n");
 				exit(EXIT_FAILURE);
@@ -116,6 +162,151 @@ std::vector<std::string> GetPartialSubdirectories(std::string dirName) {
 	return result;
 }
 
+void ReadPartialHotspots(PartialFile* partialFile, std::vector<HotspotCoordsWithProbability>* points) {
+	while (!feof(partialFile->fileStream)) {
+		HotspotCoordsWithProbability newCoord;
+		if(!fscanf(partialFile->fileStream, "%6hd", &(newCoord.moonLat))) {
+			printf("Error: Could not read moonLat from file: \"%s\".\n",
+					partialFile->filename.c_str());
+			exit(EXIT_FAILURE);
+		}
+		if(!fscanf(partialFile->fileStream, "%6hd", &(newCoord.moonLong))) {
+			printf("Error: Could not read moonLong from file: \"%s\".\n",
+					partialFile->filename.c_str());
+			exit(EXIT_FAILURE);
+		}
+		if(!fscanf(partialFile->fileStream, "%6hd", &(newCoord.marsLat))) {
+			printf("Error: Could not read marsLat from file: \"%s\".\n",
+					partialFile->filename.c_str());
+			exit(EXIT_FAILURE);
+		}
+		if(!fscanf(partialFile->fileStream, "%6hd", &(newCoord.marsLong))) {
+			printf("Error: Could not read marsLong from file: \"%s\".\n",
+					partialFile->filename.c_str());
+			exit(EXIT_FAILURE);
+		}
+		if(!fscanf(partialFile->fileStream, "%46Le\n", &(newCoord.prob))) {
+			printf("Error: Could not read prob from file: \"%s\".\n",
+					partialFile->filename.c_str());
+			exit(EXIT_FAILURE);
+		}
+		points->push_back(newCoord);
+	}
+}
+
+// reads the header of a partial file, leaving the stream at its first hotspot
+void ReadPartialHeader(PartialFile* partialFile) {
+	if(fscanf(partialFile->fileStream, "!! THIS IS A PARTIAL FILE !!\n") != 0) {
+		printf("Error: Could not read \"!! THIS IS A PARTIAL FILE !!\" from file: \"%s\".\n",
+				partialFile->filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	if(!fscanf(partialFile->fileStream, "START INDEX = %7d\n", &(partialFile->startIndex))) {
+		printf("Error: Could not read startIndex from file: \"%s\".\n", partialFile->filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	if(!fscanf(partialFile->fileStream, "END   INDEX = %7d\n", &(partialFile->endIndex))) {
+		printf("Error: Could not read endIndex from file: \"%s\".\n", partialFile->filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	if(!fscanf(partialFile->fileStream, "GRID  RES   = %7d\n", &(partialFile->gridRes))) {
+		printf("Error: Could not read gridRes from file: \"%s\".\n", partialFile->filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	if(!fscanf(partialFile->fileStream, "INCREMENT   = %7d\n", &(partialFile->increment))) {
+		printf("Error: Could not read increment from file: \"%s\".\n", partialFile->filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	if(!fscanf(partialFile->fileStream, "INTERVAL    = %7d\n", &(partialFile->interval))) {
+		printf("Error: Could not read interval from file: \"%s\".\n", partialFile->filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	partialFile->dedupObserved = "missing";
+	
+	char buff[1024];
+	fscanf(partialFile->fileStream, "%s", buff);
+	
+	if(strcmp(buff, "DEDUP") == 0) {
+		if(!fscanf(partialFile->fileStream, " OBS   = %7s\n\n", buff)) {
+			printf("Error: Could not read dedup obs from file: \"%s\".\n", partialFile->filename.c_str());
+			exit(EXIT_FAILURE);
+		}
+		
+		if (strcmp(buff, "TRUE") == 0) {
+			partialFile->dedupObserved = "true";
+		} else if (strcmp(buff, "FALSE") == 0) {
+			partialFile->dedupObserved = "false";
+		} else {
+			printf("Error: Invalid value for dedup obs in file \"%s\", string read: \"%s\".\n",
+				   partialFile->filename.c_str(), buff);
+			exit(EXIT_FAILURE);
+		}
+		
+		if(fscanf(partialFile->fileStream, "PROBABILITIES") != 0) {
+			printf("Error: Could not read \"PROBABILITIES\" from file: \"%s\".\n",
+				   partialFile->filename.c_str());
+			exit(EXIT_FAILURE);
+		}
+	} else if(strcmp(buff, "PROBABILITIES") != 0) {
+		printf("Error: Invalid token in file: \"%s\".  Expecting \"DEDUP\" or \"PROBABILITIES\".\n",
+			   partialFile->filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	
+	if(fscanf(partialFile->fileStream, " ARE NOT NORMALIZED\n\n") != 0) {
+		printf("Error: Could not read \" ARE NOT NORMALIZED\" from file: \"%s\".\n",
+			   partialFile->filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+}
+
+void PrintPartialHeader(const PartialFile* partialFile) {
+	printf("%-30s%12d%12d%12d%12d%12d%12s\n", (partialFile->directory).c_str(), partialFile->startIndex,
+		   partialFile->endIndex, partialFile->gridRes, partialFile->increment, partialFile->interval,
+		   partialFile->dedupObserved.c_str());
+}
+
+// regenerates & normalizes the combined probabilities, & writes them out
+void WriteCombinedHotspots(std::vector<HotspotCoordsWithProbability>* possibleHotspots, std::string resultsDir,
+						   std::string possibleHotspotsFilename, RegenerateMatrix* regenMat) {
+	//
+	// Regenerate coordinates
+	//
+	if (regenMat) {
+		regenMat->RegenerateProbabilities(*possibleHotspots);
+	}
+	
+	//
+	// Normalize
+	//
+	PossibleHotspotsDistribution::Normalize(possibleHotspots);
+	
+	//
+	// Write results to file
+	//
+	std::string filename = resultsDir + possibleHotspotsFilename;
+	FILE* file = fopen(filename.c_str(), "w");
+	if(!file) {
+		printf("Error: Could not open file for writing: \"%s\"\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	for(std::vector<HotspotCoordsWithProbability>::iterator it = possibleHotspots->begin(); it<possibleHotspots->end(); it++){
+		HotspotCoordsWithProbability coords = *it;
+		fprintf(file, "%s\n", coords.ToString().c_str());
+	}
+	
+	fclose(file);	
+	printf("Printed combined distribution with %zu hotspots to file: \"%s\".\n\n", possibleHotspots->size(), filename.c_str());
+}
+
 std::vector<HotspotCoordsWithProbability>* CombinePossibleHotspotFiles(std::vector<std::string> partialDirs,
 											std::string resultsDir, std::string possibleHotspotsFilename, RegenerateMatrix* regenMat) {
 	std::vector<PartialFile*> partialFiles;
@@ -124,10 +315,10 @@ std::vector<HotspotCoordsWithProbability>* CombinePossibleHotspotFiles(std::vect
 	// open files
 	//
 	for(std::vector<std::string>::iterator it = partialDirs.begin(); it < partialDirs.end(); it++) {
-		const char* filename = (*it + possibleHotspotsFilename).c_str();
-		FILE* file = fopen(filename, "r");
+		std::string filename = *it + possibleHotspotsFilename;
+		FILE* file = fopen(filename.c_str(), "r");
 		if(!file) {
-			printf("Error: Could not open file for reading: \"%s\"\n", filename);
+			printf("Error: Could not open file for reading: \"%s\"\n", filename.c_str());
 			exit(EXIT_FAILURE);
 		}
 		
@@ -145,81 +336,8 @@ std::vector<HotspotCoordsWithProbability>* CombinePossibleHotspotFiles(std::vect
 	//
 	std::vector<PartialFile*>::iterator it;
 	for(it = partialFiles.begin(); it < partialFiles.end(); it++) {
-		PartialFile* partialFile = *it;
-		
-		if(fscanf(partialFile->fileStream, "!! THIS IS A PARTIAL FILE !!\n") != 0) {
-			printf("Error: Could not read \"!! THIS IS A PARTIAL FILE !!\" from file: \"%s\".\n",
-					partialFile->filename.c_str());
-			exit(EXIT_FAILURE);
-		}
-		
-		if(!fscanf(partialFile->fileStream, "START INDEX = %7d\n", &(partialFile->startIndex))) {
-			printf("Error: Could not read startIndex from file: \"%s\".\n", partialFile->filename.c_str());
-			exit(EXIT_FAILURE);
-		}
-		
-		if(!fscanf(partialFile->fileStream, "END   INDEX = %7d\n", &(partialFile->endIndex))) {
-			printf("Error: Could not read endIndex from file: \"%s\".\n", partialFile->filename.c_str());
-			exit(EXIT_FAILURE);
-		}
-		
-		if(!fscanf(partialFile->fileStream, "GRID  RES   = %7d\n", &(partialFile->gridRes))) {
-			printf("Error: Could not read gridRes from file: \"%s\".\n", partialFile->filename.c_str());
-			exit(EXIT_FAILURE);
-		}
-		
-		if(!fscanf(partialFile->fileStream, "INCREMENT   = %7d\n", &(partialFile->increment))) {
-			printf("Error: Could not read increment from file: \"%s\".\n", partialFile->filename.c_str());
-			exit(EXIT_FAILURE);
-		}
-		
-		if(!fscanf(partialFile->fileStream, "INTERVAL    = %7d\n", &(partialFile->interval))) {
-			printf("Error: Could not read interval from file: \"%s\".\n", partialFile->filename.c_str());
-			exit(EXIT_FAILURE);
-		}
-		
-		partialFile->dedupObserved = "missing";
-		
-		char buff[1024];
-		fscanf(partialFile->fileStream, "%s", buff);
-		
-		if(strcmp(buff, "DEDUP") == 0) {
-			if(!fscanf(partialFile->fileStream, " OBS   = %7s\n\n", buff)) {
-				printf("Error: Could not read dedup obs from file: \"%s\".\n", partialFile->filename.c_str());
-				exit(EXIT_FAILURE);
-			}
-			
-			if (strcmp(buff, "TRUE") == 0) {
-				partialFile->dedupObserved = "true";
-			} else if (strcmp(buff, "FALSE") == 0) {
-				partialFile->dedupObserved = "false";
-			} else {
-				printf("Error: Invalid value for dedup obs in file \"%s\", string read: \"%s\".\n",
-					   partialFile->filename.c_str(), buff);
-				exit(EXIT_FAILURE);
-			}
-			
-			if(fscanf(partialFile->fileStream, "PROBABILITIES") != 0) {
-				printf("Error: Could not read \"PROBABILITIES\" from file: \"%s\".\n",
-					   partialFile->filename.c_str());
-				exit(EXIT_FAILURE);
-			}
-		} else if(strcmp(buff, "PROBABILITIES") != 0) {
-			printf("Error: Invalid token in file: \"%s\".  Expecting \"DEDUP\" or \"PROBABILITIES\".\n",
-				   partialFile->filename.c_str());
-			exit(EXIT_FAILURE);
-		}
-
-		
-		if(fscanf(partialFile->fileStream, " ARE NOT NORMALIZED\n\n") != 0) {
-			printf("Error: Could not read \" ARE NOT NORMALIZED\" from file: \"%s\".\n",
-				   partialFile->filename.c_str());
-			exit(EXIT_FAILURE);
-		}
-		
-		printf("%-30s%12d%12d%12d%12d%12d%12s\n", (partialFile->directory).c_str(), partialFile->startIndex,
-			   partialFile->endIndex, partialFile->gridRes, partialFile->increment, partialFile->interval,
-			   partialFile->dedupObserved.c_str());
+		ReadPartialHeader(*it);
+		PrintPartialHeader(*it);
 	}
 	printf("\n");
 	
@@ -248,141 +366,66 @@ std::vector<HotspotCoordsWithProbability>* CombinePossibleHotspotFiles(std::vect
 	}
 	
 	//
-	// Read possible hotspots, and verify matches
+	// Read possible hotspots, matching the coordinates of every file to
+	// those of the first file, and verify matches
 	//
 	std::vector<HotspotCoordsWithProbability>* possibleHotspots;
 	possibleHotspots = new std::vector<HotspotCoordsWithProbability>();
-	int count = 0;
-	while (true) {
-		// check if end of files is reached, and verify end of all files
-		// is reached simultaneously
-		PartialFile* firstFile = *(partialFiles.begin());
-		bool filesEnded = feof(firstFile->fileStream);
-		for(it = partialFiles.begin(); it < partialFiles.end(); it++) {
-			PartialFile* partialFile = *it;
-			if(feof(partialFile->fileStream) != filesEnded) {
-				printf("Error: Files have differing number of lines:\n");
-				printf("%s\n", firstFile->filename.c_str());
-				printf("%s\n", partialFile->filename.c_str());
-				exit(EXIT_FAILURE);
-			}
+	ReadPartialHotspots(*(partialFiles.begin()), possibleHotspots);
+	HotspotIndex index(*possibleHotspots);
+	
+	std::vector<bool> probRead(possibleHotspots->size(), false);
+	for(it = partialFiles.begin(); it < partialFiles.end(); it++) {
+		PartialFile* partialFile = *it;
+		std::vector<HotspotCoordsWithProbability> otherPoints;
+		if(it != partialFiles.begin())
+			ReadPartialHotspots(partialFile, &otherPoints);
+		const std::vector<HotspotCoordsWithProbability> &points = it == partialFiles.begin() ? *possibleHotspots : otherPoints;
+		
+		if(points.size() != possibleHotspots->size()) {
+			printf("Error: Files have differing number of lines:\n");
+			printf("%s\n", (*partialFiles.begin())->filename.c_str());
+			printf("%s\n", partialFile->filename.c_str());
+			exit(EXIT_FAILURE);
 		}
-		if (filesEnded)
-			break;
 		
-		// read one coord from each of the files, and verify match
-		HotspotCoordsWithProbability coord;
-		bool readCoords = false;
-		bool readProb = false;
-		for(it = partialFiles.begin(); it < partialFiles.end(); it++) {
-			PartialFile* partialFile = *it;
-			HotspotCoordsWithProbability newCoord;
-			if(!fscanf(partialFile->fileStream, "%6hd", &(newCoord.moonLat))) {
-				printf("Error: Could not read moonLat from file: \"%s\".\n",
-						partialFile->filename.c_str());
-				exit(EXIT_FAILURE);
-			}
-			if(!fscanf(partialFile->fileStream, "%6hd", &(newCoord.moonLong))) {
-				printf("Error: Could not read moonLong from file: \"%s\".\n",
-						partialFile->filename.c_str());
-				exit(EXIT_FAILURE);
-			}
-			if(!fscanf(partialFile->fileStream, "%6hd", &(newCoord.marsLat))) {
-				printf("Error: Could not read marsLat from file: \"%s\".\n",
-						partialFile->filename.c_str());
-				exit(EXIT_FAILURE);
-			}
-			if(!fscanf(partialFile->fileStream, "%6hd", &(newCoord.marsLong))) {
-				printf("Error: Could not read marsLong from file: \"%s\".\n",
-						partialFile->filename.c_str());
-				exit(EXIT_FAILURE);
-			}
-			if(!fscanf(partialFile->fileStream, "%46Le\n", &(newCoord.prob))) {
-				printf("Error: Could not read prob from file: \"%s\".\n",
-						partialFile->filename.c_str());
+		for(int j = 0; j < (int)points.size(); j++) {
+			const HotspotCoordsWithProbability &newCoord = points[j];
+			int position = index.Find(newCoord);
+			if(position < 0) {
+				printf("Error: Coordinate %d of file \"%s\" is not in file \"%s\": %s.\n", j+1,
+					   partialFile->filename.c_str(), (*partialFiles.begin())->filename.c_str(),
+					   ((HotspotCoords)newCoord).ToString().c_str());
 				exit(EXIT_FAILURE);
 			}
 			
-			if (readCoords) {
-				if (coord != newCoord) {
-					printf("Error: Coordinate mismatch in coordinate %d while reading file \"%s\":\n",
-							count+1, partialFile->filename.c_str());
-					printf("Old: %s.\n", coord.ToString().c_str());
-					printf("New: %s.\n",  newCoord.ToString().c_str());
-					exit(EXIT_FAILURE);
-				}
-			} else {
-				coord.moonLat = newCoord.moonLat;
-				coord.moonLong = newCoord.moonLong;
-				coord.marsLat = newCoord.marsLat;
-				coord.marsLong = newCoord.marsLong;
-				readCoords = true;
-			}
-			
-			if (count+1 >= partialFile->startIndex &&
-				count+1 <= partialFile->endIndex) {
-				if (readProb) {
+			if (j+1 >= partialFile->startIndex &&
+				j+1 <= partialFile->endIndex) {
+				HotspotCoordsWithProbability &coord = (*possibleHotspots)[position];
+				if (probRead[position]) {
 					if (coord.prob != newCoord.prob) {
 						printf("Error: Probability mismatch in coordinate %d while reading file \"%s\":\n",
-								count+1, partialFile->filename.c_str());
+								j+1, partialFile->filename.c_str());
 						printf("Old: %s.\n", coord.ToString().c_str());
 						printf("New: %s.\n",  newCoord.ToString().c_str());
 						exit(EXIT_FAILURE);
 					}
 				} else {
 					coord.prob = newCoord.prob;
-					readProb = true;
+					probRead[position] = true;
 				}
 			}
 		}
-		if (!readCoords) {
-			printf("Error: Coordinate %d was not read.\n", count+1);
-			exit(EXIT_FAILURE);
-		}
-		if (!readProb) {
-			printf("Error: Probability for coordinate %d was not found in any of the files.\n", count+1);
-			exit(EXIT_FAILURE);
-		}
-		
-		possibleHotspots->push_back(coord);
-		count++;
-	}
-	
-	if (count != (int)possibleHotspots->size()) {
-		printf("Error: Coordinate count, %d, does not match size of coordinate vector, %zu.\n\n",
-				count, possibleHotspots->size());
-		exit(EXIT_FAILURE);
 	}
 	
-	//
-	// Regenerate coordinates
-	//
-	if (regenMat) {
-		regenMat->RegenerateProbabilities(*possibleHotspots);
-	}
-	
-	//
-	// Normalize
-	//
-	PossibleHotspotsDistribution::Normalize(possibleHotspots);
-	
-	//
-	// Write results to file
-	//
-	std::string filename = resultsDir + possibleHotspotsFilename;
-	FILE* file = fopen(filename.c_str(), "w");
-	if(!file) {
-		printf("Error: Could not open file for writing: \"%s\"\n", filename.c_str());
-		exit(EXIT_FAILURE);
-	}
-	
-	for(std::vector<HotspotCoordsWithProbability>::iterator it = possibleHotspots->begin(); it<possibleHotspots->end(); it++){
-		HotspotCoordsWithProbability coords = *it;
-		fprintf(file, "%s\n", coords.ToString().c_str());
+	for(unsigned int i = 0; i < probRead.size(); i++) {
+		if (!probRead[i]) {
+			printf("Error: Probability for coordinate %d was not found in any of the files.\n", i+1);
+			exit(EXIT_FAILURE);
+		}
 	}
 	
-	fclose(file);	
-	printf("Printed combined distribution with %zu hotspots to file: \"%s\".\n\n", possibleHotspots->size(), filename.c_str());
+	WriteCombinedHotspots(possibleHotspots, resultsDir, possibleHotspotsFilename, regenMat);
 	
 	//
 	// Close files
@@ -471,10 +514,144 @@ void VerifyAndCopyMatchingFiles(std::vector<std::string> directories, std::strin
 	free(bytes);
 }
 
+// the manifest of every directory, or none if any directory lacks one
+std::vector<Manifest> ReadManifests(std::vector<std::string> directories, std::string filename) {
+	std::vector<Manifest> manifests;
+	for (std::vector<std::string>::iterator dir=directories.begin(); dir<directories.end(); dir++) {
+		std::string fullFileName = *dir+filename;
+		if (!std::ifstream(fullFileName.c_str())) {
+			printf("No manifest in \"%s\", so the shared files are compared byte by byte.\n\n", dir->c_str());
+			return std::vector<Manifest>();
+		}
+		manifests.push_back(Manifest(fullFileName));
+	}
+	return manifests;
+}
+
+// false, having printed the difference, if a manifest differs from the
+// first in the parameter
+bool ManifestParameterMatches(std::vector<std::string> directories, const std::vector<Manifest> &manifests, std::string name) {
+	for (unsigned int i = 0; i < manifests.size(); i++) {
+		if (manifests[i].GetParameter(name) != manifests[0].GetParameter(name)) {
+			printf("Incompatible manifests:\n");
+			printf("%s has %s = %s\n", directories[0].c_str(), name.c_str(), manifests[0].GetParameter(name).c_str());
+			printf("%s has %s = %s\n", directories[i].c_str(), name.c_str(), manifests[i].GetParameter(name).c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ManifestsMatch(std::vector<std::string> directories, const std::vector<Manifest> &manifests) {
+	if (!ManifestParameterMatches(directories, manifests, "hotspotCount") ||
+		!ManifestParameterMatches(directories, manifests, "hotspotDigest") ||
+		!ManifestParameterMatches(directories, manifests, "deduplicateObserved") ||
+		!ManifestParameterMatches(directories, manifests, "continuous"))
+		return false;
+	
+	// the grid itself must match, though it may be stepped through differently
+	for (unsigned int i = 0; i < manifests.size(); i++) {
+		long int gridRes = atol(manifests[i].GetParameter("gridRes").c_str());
+		long int increment = atol(manifests[i].GetParameter("increment").c_str());
+		long int initGridRes = atol(manifests[0].GetParameter("gridRes").c_str());
+		long int initIncrement = atol(manifests[0].GetParameter("increment").c_str());
+		if(gridRes * initIncrement != initGridRes * increment) {
+			printf("Incompatible manifests:\n");
+			printf("%s has gridRes = %ld, increment = %ld\n", directories[0].c_str(), initGridRes, initIncrement);
+			printf("%s has gridRes = %ld, increment = %ld\n", directories[i].c_str(), gridRes, increment);
+			return false;
+		}
+	}
+	return true;
+}
+
+void VerifyManifests(std::vector<std::string> directories, const std::vector<Manifest> &manifests) {
+	if (!ManifestsMatch(directories, manifests)) {
+		printf("Error: The partial results cannot be combined.\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// false, having printed the difference, if a manifest differs from the
+// first in whether it lists the file or in its digest
+bool ManifestFileMatches(std::vector<std::string> directories, const std::vector<Manifest> &manifests, std::string filename) {
+	for (unsigned int i = 0; i < manifests.size(); i++) {
+		if (manifests[i].HasFile(filename) != manifests[0].HasFile(filename)) {
+			printf("Manifest of %s %s %s, but manifest of %s %s.\n",
+				   directories[0].c_str(), manifests[0].HasFile(filename) ? "lists" : "does not list", filename.c_str(),
+				   directories[i].c_str(), manifests[i].HasFile(filename) ? "does" : "does not");
+			return false;
+		}
+		if (manifests[0].HasFile(filename) && (manifests[i].GetDigest(filename) != manifests[0].GetDigest(filename) ||
+											   manifests[i].GetSize(filename) != manifests[0].GetSize(filename))) {
+			printf("Files do not match:\n");
+			printf("%s\n", (directories[0] + filename).c_str());
+			printf("%s\n", (directories[i] + filename).c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ManifestsListFile(std::vector<std::string> directories, const std::vector<Manifest> &manifests, std::string filename) {
+	if (!ManifestFileMatches(directories, manifests, filename)) {
+		printf("Error: The partial results cannot be combined.\n");
+		exit(EXIT_FAILURE);
+	}
+	return manifests[0].HasFile(filename);
+}
+
+// compares the digests of the file in the manifests, and copies the file of
+// the first directory, checking it against its digest as it is copied
+void VerifyAndCopyByDigest(std::vector<std::string> directories, const std::vector<Manifest> &manifests, std::string resultsDir,
+						   std::string filename) {
+	if (!ManifestsListFile(directories, manifests, filename)) {
+		printf("Error: Manifest of %s does not list file %s.\n", directories[0].c_str(), filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	std::string inFileName = directories[0] + filename;
+	FILE* inFile = fopen(inFileName.c_str(), "rb");
+	if(!inFile) {
+		printf("Error: Could not open file for reading: \"%s\"\n", inFileName.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	std::string outFileName = resultsDir + filename;
+	FILE* outFile = fopen(outFileName.c_str(), "wb");
+	if(!outFile) {
+		printf("Error: Could not open file for writing: \"%s\"\n", outFileName.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	Sha256 digest;
+	char buff[65536];
+	size_t count;
+	while ((count = fread(buff, 1, sizeof(buff), inFile)) > 0) {
+		digest.Update(buff, count);
+		if (fwrite(buff, 1, count, outFile) != count) {
+			printf("Error: Could not write to file: \"%s\"\n", outFileName.c_str());
+			exit(EXIT_FAILURE);
+		}
+	}
+	fclose(inFile);
+	if (fclose(outFile) != 0) {
+		printf("Error: Could not write to file: \"%s\"\n", outFileName.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	if (digest.Final() != manifests[0].GetDigest(filename)) {
+		printf("Error: File does not match the digest in its manifest: \"%s\"\n", inFileName.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	printf("Output file: \"%s\".\n", outFileName.c_str());
+}
+
 bool AllFilesExist(std::vector<std::string> directories, std::string filename) {
 	std::string firstFullFileName = *(directories.begin())+filename;
 	std::ifstream firstStream(firstFullFileName.c_str());
-	bool filesExist = firstStream;
+	bool filesExist = (bool)firstStream;
 	
 	for (std::vector<std::string>::iterator dir=directories.begin(); dir<directories.end(); dir++) {
 		std::string fullFileName = *dir+filename;
@@ -490,39 +667,7 @@ bool AllFilesExist(std::vector<std::string> directories, std::string filename) {
 	return filesExist;
 }
 
-int main(int argc, char* argv[]) {
-	Params params = DefaultParams();	
-	ParseArguments(argc, argv, params);
-	StandardizeDirectoryNames(params);
-	
-	printf("======================================================================================================\n");
-	
-	std::vector<std::string> partialDirs = GetPartialSubdirectories(params.resultsDir);
-	if (partialDirs.empty()) {
-		printf("Error: No directories found containg partial results.\n");
-		exit(EXIT_FAILURE);
-	}
-	
-	VerifyAndCopyMatchingFiles(partialDirs, params.resultsDir, params.inputFile);
-	VerifyAndCopyMatchingFiles(partialDirs, params.resultsDir, params.limitsFile);
-	VerifyAndCopyMatchingFiles(partialDirs, params.resultsDir, params.abcdDistFile);
-	
-	RegenerateMatrix* regenMat = NULL;
-	if(AllFilesExist(partialDirs, params.mFile))
-	{
-		VerifyAndCopyMatchingFiles(partialDirs, params.resultsDir, params.mFile);
-		printf("\n");
-		regenMat = new RegenerateMatrix(params.resultsDir + params.mFile);
-		printf("\n");
-	}
-	printf("------------------------------------------------------------------------------------------------------\n");
-	
-	std::vector<HotspotCoordsWithProbability>* possibleHotspotsVec;
-	possibleHotspotsVec = CombinePossibleHotspotFiles(partialDirs, params.resultsDir, params.possibleHotspotsFile, regenMat);
-	
-	//
-	// Determine nonremovable hotspots and probability
-	//
+void WriteNonremovableProbability(const Params &params, std::vector<HotspotCoordsWithProbability>* possibleHotspotsVec) {
 	PossibleHotspotsDistribution possibleHotspots(possibleHotspotsVec);
 	ObservedHotspots observedHotspots(params.resultsDir + params.inputFile);
 	AbcdSpaceLimits limits(observedHotspots, false);
@@ -551,9 +696,365 @@ int main(int argc, char* argv[]) {
 	printf("%.36Lg%%\n", 100*accumProb);
 	printf("Probability of getting a removable & removing point next month:\n");
 	printf("%.36Lg%%\n", 100*(1-accumProb));
-	//
-	// End nonremovable hotspots and probability
-	//
+}
+
+// verifies the files every shard shares & copies them to the results
+// directory, by the digests in the manifests if there are any; returns the
+// regenerate matrix if the shards have an M file, or NULL
+RegenerateMatrix* CopySharedFiles(const Params &params, std::vector<std::string> partialDirs, const std::vector<Manifest> &manifests) {
+	bool hasMfile;
+	if (!manifests.empty()) {
+		VerifyManifests(partialDirs, manifests);
+		VerifyAndCopyByDigest(partialDirs, manifests, params.resultsDir, params.inputFile);
+		VerifyAndCopyByDigest(partialDirs, manifests, params.resultsDir, params.limitsFile);
+		VerifyAndCopyByDigest(partialDirs, manifests, params.resultsDir, params.abcdDistFile);
+		hasMfile = ManifestsListFile(partialDirs, manifests, params.mFile);
+		if (hasMfile)
+			VerifyAndCopyByDigest(partialDirs, manifests, params.resultsDir, params.mFile);
+	} else {
+		VerifyAndCopyMatchingFiles(partialDirs, params.resultsDir, params.inputFile);
+		VerifyAndCopyMatchingFiles(partialDirs, params.resultsDir, params.limitsFile);
+		VerifyAndCopyMatchingFiles(partialDirs, params.resultsDir, params.abcdDistFile);
+		hasMfile = AllFilesExist(partialDirs, params.mFile);
+		if (hasMfile)
+			VerifyAndCopyMatchingFiles(partialDirs, params.resultsDir, params.mFile);
+	}
+	
+	RegenerateMatrix* regenMat = NULL;
+	if(hasMfile)
+	{
+		printf("\n");
+		regenMat = new RegenerateMatrix(params.resultsDir + params.mFile);
+		printf("\n");
+	}
+	return regenMat;
+}
+
+// a shard seen by the watch, with the probabilities of its own range
+struct WatchedShard {
+	std::string directory;
+	time_t manifestTime;
+	// false if its partial file could not be read, until it is rerun
+	bool loaded;
+	Manifest manifest;
+	std::string key;
+	int first;
+	int last;
+	std::vector<Double> probs;
+};
+
+// shards with the same key can be combined: it holds the parameters & the
+// digests of the shared files their manifests must agree on, with the grid
+// reduced to the ratio of its resolution & increment
+std::string CompatibilityKey(const Params &params, const Manifest &manifest) {
+	long int gridRes = atol(manifest.GetParameter("gridRes").c_str());
+	long int increment = atol(manifest.GetParameter("increment").c_str());
+	long int divisor = gridRes;
+	for (long int rest = increment; rest != 0;) {
+		long int next = divisor % rest;
+		divisor = rest;
+		rest = next;
+	}
+	if (divisor == 0)
+		divisor = 1;
+	
+	char grid[64];
+	sprintf(grid, "%ld/%ld", gridRes/divisor, increment/divisor);
+	std::string key = manifest.GetParameter("hotspotCount") + " " + manifest.GetParameter("hotspotDigest") + " " +
+					  manifest.GetParameter("deduplicateObserved") + " " + manifest.GetParameter("continuous") + " " + grid;
+	
+	std::string files[4] = {params.inputFile, params.limitsFile, params.abcdDistFile, params.mFile};
+	for (int i = 0; i < 4; i++)
+		key += " " + (manifest.HasFile(files[i]) ? manifest.GetDigest(files[i]) : std::string("-"));
+	return key;
+}
+
+// reads the manifest & partial file of the shard; the coordinates of the
+// hotspots are kept once for each key
+void LoadShard(const Params &params, WatchedShard* shard,
+			   std::map<std::string, std::vector<HotspotCoordsWithProbability> >* keyHotspots) {
+	shard->manifest = Manifest(shard->directory + params.manifestFile);
+	shard->key = CompatibilityKey(params, shard->manifest);
+	shard->probs.clear();
+	shard->loaded = false;
+	
+	PartialFile partialFile;
+	partialFile.directory = shard->directory;
+	partialFile.filename = shard->directory + params.possibleHotspotsFile;
+	partialFile.fileStream = fopen(partialFile.filename.c_str(), "r");
+	if(!partialFile.fileStream) {
+		printf("Could not open file for reading: \"%s\"\n", partialFile.filename.c_str());
+		return;
+	}
+	
+	ReadPartialHeader(&partialFile);
+	PrintPartialHeader(&partialFile);
+	std::vector<HotspotCoordsWithProbability> points;
+	ReadPartialHotspots(&partialFile, &points);
+	fclose(partialFile.fileStream);
+	
+	long int hotspotCount = atol(shard->manifest.GetParameter("hotspotCount").c_str());
+	if ((long int)points.size() != hotspotCount || partialFile.startIndex < 1 || partialFile.endIndex > (int)points.size()) {
+		printf("File \"%s\" does not have the %ld hotspots of its manifest.\n", partialFile.filename.c_str(), hotspotCount);
+		return;
+	}
+	
+	shard->first = partialFile.startIndex - 1;
+	shard->last = partialFile.endIndex - 1;
+	for (int j = shard->first; j <= shard->last; j++)
+		shard->probs.push_back(points[j].prob);
+	shard->loaded = true;
+	if (keyHotspots->count(shard->key) == 0)
+		(*keyHotspots)[shard->key] = points;
+}
+
+// the loaded shards with the key, most recently written first, so that a
+// rerun takes precedence over an older shard it conflicts with
+std::vector<const WatchedShard*> ShardsWithKey(const std::map<std::string, WatchedShard> &shards, std::string key) {
+	std::vector<const WatchedShard*> result;
+	for (std::map<std::string, WatchedShard>::const_iterator it = shards.begin(); it != shards.end(); it++) {
+		if (it->second.loaded && it->second.key == key)
+			result.push_back(&it->second);
+	}
+	for (unsigned int i = 1; i < result.size(); i++) {
+		for (unsigned int j = i; j > 0 && result[j]->manifestTime > result[j - 1]->manifestTime; j--)
+			std::swap(result[j], result[j - 1]);
+	}
+	return result;
+}
+
+// merges the shards into the probabilities, skipping any that conflicts
+// with one already merged, and returns those merged
+std::vector<const WatchedShard*> MergeShards(const std::vector<const WatchedShard*> &shards, bool report,
+											 std::vector<Double>* probs, std::vector<bool>* probRead, int* numRead) {
+	std::vector<const WatchedShard*> merged;
+	for (unsigned int s = 0; s < shards.size(); s++) {
+		const WatchedShard &shard = *shards[s];
+		int conflictStart = -1;
+		bool conflicts = false;
+		for (int j = shard.first; j <= shard.last + 1; j++) {
+			bool conflict = j <= shard.last && (*probRead)[j] && (*probs)[j] != shard.probs[j - shard.first];
+			if (conflict && conflictStart < 0)
+				conflictStart = j;
+			if (!conflict && conflictStart >= 0) {
+				if (report)
+					printf("Conflict: Probabilities %d-%d of \"%s\" differ from those of a newer shard.\n",
+						   conflictStart + 1, j, shard.directory.c_str());
+				conflictStart = -1;
+				conflicts = true;
+			}
+		}
+		if (conflicts) {
+			if (report)
+				printf("Skipped \"%s\".\n", shard.directory.c_str());
+			continue;
+		}
+		
+		for (int j = shard.first; j <= shard.last; j++) {
+			if (!(*probRead)[j]) {
+				(*probs)[j] = shard.probs[j - shard.first];
+				(*probRead)[j] = true;
+				(*numRead)++;
+			}
+		}
+		merged.push_back(&shard);
+	}
+	return merged;
+}
+
+// the ranges of hotspots whose probabilities have been read, or not
+void PrintRanges(const std::vector<bool> &probRead, bool covered) {
+	int rangeStart = -1;
+	for (int j = 0; j <= (int)probRead.size(); j++) {
+		bool inRange = j < (int)probRead.size() && probRead[j] == covered;
+		if (inRange && rangeStart < 0)
+			rangeStart = j;
+		if (!inRange && rangeStart >= 0) {
+			printf(" %d-%d", rangeStart + 1, j);
+			rangeStart = -1;
+		}
+	}
+}
+
+void PrintCoverage(const std::vector<bool> &probRead, int numRead) {
+	printf("Covered:");
+	PrintRanges(probRead, true);
+	printf("  (%d of %zu hotspots)\n", numRead, probRead.size());
+	fflush(stdout);
+}
+
+// the modification time of the file, or 0 if it cannot be read
+time_t GetModificationTime(std::string filename) {
+	struct stat status;
+	if (stat(filename.c_str(), &status) != 0)
+		return 0;
+	return status.st_mtime;
+}
+
+// reads each shard as soon as its manifest, which CNmoonmars writes last,
+// appears, and again whenever a rerun rewrites it.  The shards are grouped
+// by what their manifests must agree on, and the group covering the most
+// hotspots, or else holding the newest manifest, is merged, so a stale
+// shard cannot decide which others are rejected.  The results are written
+// the moment that group covers every hotspot; if the timeout passes first,
+// the hotspots still uncovered are reported and none are written
+int WatchPartialResults(const Params &params) {
+	printf("Watching \"%s\" for completed partial results.\n\n", params.resultsDir.c_str());
+	printf("%-30s%12s%12s%12s%12s%12s%12s\n", "Directory", "Start Index", "End Index", "Grid Res", "Increment", "Interval", "Dedup Obs");
+	fflush(stdout);
+	
+	std::map<std::string, WatchedShard> shards;
+	std::map<std::string, std::vector<HotspotCoordsWithProbability> > keyHotspots;
+	std::string chosenKey;
+	std::vector<const WatchedShard*> merged;
+	std::vector<Double> probs;
+	std::vector<bool> probRead;
+	int numRead = 0;
+	time_t startTime = time(NULL);
+	
+	while (true) {
+		bool changed = false;
+		for (std::map<std::string, WatchedShard>::iterator it = shards.begin(); it != shards.end();) {
+			if (GetModificationTime(it->first + params.manifestFile) == 0) {
+				shards.erase(it++);
+				changed = true;
+			} else {
+				it++;
+			}
+		}
+		
+		std::vector<std::string> partialDirs = GetPartialSubdirectories(params.resultsDir);
+		std::sort(partialDirs.begin(), partialDirs.end());
+		for (std::vector<std::string>::iterator dir = partialDirs.begin(); dir < partialDirs.end(); dir++) {
+			time_t manifestTime = GetModificationTime(*dir + params.manifestFile);
+			if (manifestTime == 0 || (shards.count(*dir) > 0 && shards[*dir].manifestTime == manifestTime))
+				continue;
+			
+			WatchedShard &shard = shards[*dir];
+			shard.directory = *dir;
+			shard.manifestTime = manifestTime;
+			LoadShard(params, &shard, &keyHotspots);
+			if (!shard.loaded)
+				printf("Skipped \"%s\".\n", dir->c_str());
+			changed = true;
+		}
+		
+		if (changed) {
+			// the group covering the most hotspots, or else with the newest
+			// manifest
+			int bestNumRead = -1;
+			time_t bestTime = 0;
+			chosenKey = "";
+			for (std::map<std::string, WatchedShard>::iterator it = shards.begin(); it != shards.end(); it++) {
+				if (!it->second.loaded || it->second.key == chosenKey)
+					continue;
+				std::vector<const WatchedShard*> group = ShardsWithKey(shards, it->second.key);
+				std::vector<Double> groupProbs(keyHotspots[it->second.key].size(), 0);
+				std::vector<bool> groupRead(groupProbs.size(), false);
+				int groupNumRead = 0;
+				MergeShards(group, false, &groupProbs, &groupRead, &groupNumRead);
+				if (groupNumRead > bestNumRead || (groupNumRead == bestNumRead && group[0]->manifestTime > bestTime)) {
+					bestNumRead = groupNumRead;
+					bestTime = group[0]->manifestTime;
+					chosenKey = it->second.key;
+				}
+			}
+			
+			merged.clear();
+			probs.assign(chosenKey == "" ? 0 : keyHotspots[chosenKey].size(), 0);
+			probRead.assign(probs.size(), false);
+			numRead = 0;
+			if (chosenKey != "") {
+				merged = MergeShards(ShardsWithKey(shards, chosenKey), true, &probs, &probRead, &numRead);
+				
+				for (std::map<std::string, WatchedShard>::iterator it = shards.begin(); it != shards.end(); it++) {
+					if (!it->second.loaded || it->second.key == chosenKey)
+						continue;
+					std::vector<std::string> pairDirs(1, merged[0]->directory);
+					pairDirs.push_back(it->first);
+					std::vector<Manifest> pair(1, merged[0]->manifest);
+					pair.push_back(it->second.manifest);
+					
+					// each check prints the difference it finds, so stop at the first
+					std::string files[4] = {params.inputFile, params.limitsFile, params.abcdDistFile, params.mFile};
+					bool matches = ManifestsMatch(pairDirs, pair);
+					for (int i = 0; i < 4 && matches; i++)
+						matches = ManifestFileMatches(pairDirs, pair, files[i]);
+					printf("Skipped \"%s\".\n", it->first.c_str());
+				}
+				PrintCoverage(probRead, numRead);
+			}
+		}
+		
+		if (chosenKey != "" && numRead == (int)probRead.size())
+			break;
+		
+		if (params.timeout > 0 && time(NULL) - startTime >= params.timeout) {
+			if (chosenKey == "") {
+				printf("\nError: No partial results were merged within the timeout of %d seconds.\n", params.timeout);
+			} else {
+				printf("\nError: Not every hotspot was covered within the timeout of %d seconds.\n", params.timeout);
+				printf("Uncovered:");
+				PrintRanges(probRead, false);
+				printf("  (%d of %zu hotspots)\n", (int)probRead.size() - numRead, probRead.size());
+			}
+			return EXIT_FAILURE;
+		}
+		fflush(stdout);
+		sleep(params.pollInterval);
+	}
+	printf("\n");
+	
+	// copied from the first directory, so in directory order
+	std::vector<std::string> mergedDirs;
+	for (unsigned int s = 0; s < merged.size(); s++)
+		mergedDirs.push_back(merged[s]->directory);
+	std::sort(mergedDirs.begin(), mergedDirs.end());
+	std::vector<Manifest> manifests;
+	for (unsigned int s = 0; s < mergedDirs.size(); s++)
+		manifests.push_back(shards[mergedDirs[s]].manifest);
+	
+	RegenerateMatrix* regenMat = CopySharedFiles(params, mergedDirs, manifests);
+	printf("------------------------------------------------------------------------------------------------------\n");
+	
+	std::vector<HotspotCoordsWithProbability>* possibleHotspotsVec = new std::vector<HotspotCoordsWithProbability>();
+	possibleHotspotsVec->swap(keyHotspots[chosenKey]);
+	for (unsigned int j = 0; j < possibleHotspotsVec->size(); j++)
+		(*possibleHotspotsVec)[j].prob = probs[j];
+	WriteCombinedHotspots(possibleHotspotsVec, params.resultsDir, params.possibleHotspotsFile, regenMat);
+	WriteNonremovableProbability(params, possibleHotspotsVec);
+	
+	delete(possibleHotspotsVec);
+	
+	printf("\nResults reassembled successfully.\n");
+	
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+	Params params = DefaultParams();	
+	ParseArguments(argc, argv, params);
+	StandardizeDirectoryNames(params);
+	
+	printf("======================================================================================================\n");
+	
+	if (params.watch)
+		return WatchPartialResults(params);
+	
+	std::vector<std::string> partialDirs = GetPartialSubdirectories(params.resultsDir);
+	if (partialDirs.empty()) {
+		printf("Error: No directories found containg partial results.\n");
+		exit(EXIT_FAILURE);
+	}
+	
+	std::vector<Manifest> manifests = ReadManifests(partialDirs, params.manifestFile);
+	RegenerateMatrix* regenMat = CopySharedFiles(params, partialDirs, manifests);
+	printf("------------------------------------------------------------------------------------------------------\n");
+	
+	std::vector<HotspotCoordsWithProbability>* possibleHotspotsVec;
+	possibleHotspotsVec = CombinePossibleHotspotFiles(partialDirs, params.resultsDir, params.possibleHotspotsFile, regenMat);
+	
+	WriteNonremovableProbability(params, possibleHotspotsVec);
 	
 	delete(possibleHotspotsVec);
 	
@@ -0,0 +1,276 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "Common.h"
+#include "HotspotCoordsWithProbability.h"
+#include "HotspotIndex.h"
+
+// Answers queries about a possible hotspots file over a Unix domain socket.
+// The file is read & indexed once, and a pool of threads, each accepting
+// connections in turn, answers from the shared read-only state.  Each
+// request is one line, & each answer starts with "OK" or "ERROR":
+//
+//   PROB moonLat moonLong marsLat marsLong
+//     OK probability
+//   REGION moonLatMin moonLatMax moonLongMin moonLongMax marsLatMin marsLatMax marsLongMin marsLongMax
+//     OK probability          (a longitude range with min > max wraps around)
+//   TOP k
+//     OK n, then the n most probable hotspots, one per line
+//   COUNT
+//     OK number of possible hotspots
+//   QUIT
+//     closes the connection
+
+struct ServerState {
+	std::vector<HotspotCoordsWithProbability> points;
+	// positions of the points, most probable first
+	std::vector<int> ranking;
+	HotspotIndex* index;
+	int listenFd;
+};
+
+std::vector<HotspotCoordsWithProbability> ReadPossibleHotspotsFile(std::string filename) {
+	FILE* file = fopen(filename.c_str(), "r");
+	if(file == NULL) {
+		printf("Error: Could not open file \"%s\".\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<HotspotCoordsWithProbability> points;
+	HotspotCoordsWithProbability newCoord;
+	while(fscanf(file, "%6hd%6hd%6hd%6hd%46Le\n", &(newCoord.moonLat), &(newCoord.moonLong),
+				 &(newCoord.marsLat), &(newCoord.marsLong), &(newCoord.prob)) == 5) {
+		points.push_back(newCoord);
+	}
+
+	if(!feof(file)) {
+		printf("Error: Could not read line %d of \"%s\".\n", (int)points.size() + 1, filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	fclose(file);
+
+	return points;
+}
+
+class CompareRanks {
+public:
+	CompareRanks(const std::vector<HotspotCoordsWithProbability>* inPoints) : points(inPoints) {}
+
+	bool operator()(int a, int b) const {
+		if ((*points)[a].prob != (*points)[b].prob)
+			return (*points)[a].prob > (*points)[b].prob;
+		return a < b;
+	}
+
+private:
+	const std::vector<HotspotCoordsWithProbability>* points;
+};
+
+bool InRange(Coord value, int min, int max) {
+	if (min <= max)
+		return value >= min && value <= max;
+	return value >= min || value <= max;
+}
+
+void AnswerProb(const ServerState &state, const char* args, FILE* out) {
+	HotspotCoords coord;
+	int values[4];
+	if (sscanf(args, "%d %d %d %d", &values[0], &values[1], &values[2], &values[3]) != 4) {
+		fprintf(out, "ERROR PROB expects moonLat moonLong marsLat marsLong\n");
+		return;
+	}
+	coord.moonLat = values[0];
+	coord.moonLong = values[1];
+	coord.marsLat = values[2];
+	coord.marsLong = values[3];
+
+	if (!HotspotIndex::IsValid(coord)) {
+		fprintf(out, "ERROR Coordinates out of range\n");
+		return;
+	}
+
+	int position = state.index->Find(coord);
+	Double prob = position < 0 ? 0 : state.points[position].prob;
+	fprintf(out, "OK %.36Le\n", prob);
+}
+
+void AnswerRegion(const ServerState &state, const char* args, FILE* out) {
+	int mins[4], maxs[4];
+	if (sscanf(args, "%d %d %d %d %d %d %d %d", &mins[0], &maxs[0], &mins[1], &maxs[1],
+			   &mins[2], &maxs[2], &mins[3], &maxs[3]) != 8) {
+		fprintf(out, "ERROR REGION expects a min & max for each of the four coordinates\n");
+		return;
+	}
+
+	Double prob = 0;
+	for (std::vector<HotspotCoordsWithProbability>::const_iterator it = state.points.begin(); it != state.points.end(); ++it) {
+		if (InRange(it->moonLat, mins[0], maxs[0]) && InRange(it->moonLong, mins[1], maxs[1]) &&
+			InRange(it->marsLat, mins[2], maxs[2]) && InRange(it->marsLong, mins[3], maxs[3]))
+			prob += it->prob;
+	}
+	fprintf(out, "OK %.36Le\n", prob);
+}
+
+void AnswerTop(const ServerState &state, const char* args, FILE* out) {
+	int k;
+	if (sscanf(args, "%d", &k) != 1 || k < 0) {
+		fprintf(out, "ERROR TOP expects a number of hotspots\n");
+		return;
+	}
+
+	int n = std::min(k, (int)state.ranking.size());
+	fprintf(out, "OK %d\n", n);
+	for (int i = 0; i < n; i++)
+		fprintf(out, "%s\n", state.points[state.ranking[i]].ToString().c_str());
+}
+
+// answers the requests of one connection until it closes or sends QUIT
+void ServeConnection(const ServerState &state, int fd) {
+	FILE* in = fdopen(fd, "r");
+	FILE* out = fdopen(dup(fd), "w");
+	if (in == NULL || out == NULL) {
+		printf("Warning: Could not open connection streams.\n");
+		if (in) fclose(in); else close(fd);
+		if (out) fclose(out);
+		return;
+	}
+
+	char line[1024];
+	while (fgets(line, sizeof(line), in) != NULL) {
+		char command[16] = "";
+		int length = 0;
+		if (sscanf(line, "%15s%n", command, &length) != 1)
+			continue;
+		const char* args = line + length;
+
+		if (strcmp(command, "PROB") == 0)
+			AnswerProb(state, args, out);
+		else if (strcmp(command, "REGION") == 0)
+			AnswerRegion(state, args, out);
+		else if (strcmp(command, "TOP") == 0)
+			AnswerTop(state, args, out);
+		else if (strcmp(command, "COUNT") == 0)
+			fprintf(out, "OK %d\n", (int)state.points.size());
+		else if (strcmp(command, "QUIT") == 0)
+			break;
+		else
+			fprintf(out, "ERROR Unknown command \"%s\"\n", command);
+
+		if (fflush(out) != 0)
+			break;
+	}
+
+	fclose(out);
+	fclose(in);
+}
+
+void* Worker(void* arg) {
+	const ServerState &state = *(const ServerState*)arg;
+	while (true) {
+		int fd = accept(state.listenFd, NULL, NULL);
+		if (fd < 0) {
+			// a persistent error, such as running out of descriptors, is
+			// retried after a pause rather than spinning
+			if (errno != EINTR && errno != ECONNABORTED) {
+				printf("Warning: Could not accept a connection: %s\n", strerror(errno));
+				fflush(stdout);
+				sleep(1);
+			}
+			continue;
+		}
+		ServeConnection(state, fd);
+	}
+	return NULL;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc != 3 && argc != 4) {
+		printf("Usage: ./CNmoonmarsServe possibleHotspotsFile socketPath [numThreads]\n");
+		return EXIT_FAILURE;
+	}
+
+	int numThreads = argc == 4 ? atoi(argv[3]) : 4;
+	if (numThreads < 1) {
+		printf("Error: The number of threads must be at least 1.\n");
+		return EXIT_FAILURE;
+	}
+
+	ServerState state;
+	state.points = ReadPossibleHotspotsFile(argv[1]);
+	state.index = new HotspotIndex(state.points);
+	for (unsigned int i = 0; i < state.points.size(); i++)
+		state.ranking.push_back(i);
+	std::sort(state.ranking.begin(), state.ranking.end(), CompareRanks(&state.points));
+	printf("Loaded %d possible hotspots from \"%s\".\n", (int)state.points.size(), argv[1]);
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(argv[2]) >= sizeof(address.sun_path)) {
+		printf("Error: Socket path is too long: \"%s\"\n", argv[2]);
+		return EXIT_FAILURE;
+	}
+	strcpy(address.sun_path, argv[2]);
+
+	// only a socket left by an earlier run, which refuses connections, is
+	// removed, never another file or the socket of a running server
+	struct stat status;
+	if (lstat(argv[2], &status) == 0) {
+		if (!S_ISSOCK(status.st_mode)) {
+			printf("Error: \"%s\" exists & is not a socket.\n", argv[2]);
+			return EXIT_FAILURE;
+		}
+		int probeFd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (probeFd < 0) {
+			printf("Error: Could not create a socket: %s\n", strerror(errno));
+			return EXIT_FAILURE;
+		}
+		int probeError = 0;
+		if (connect(probeFd, (struct sockaddr*)&address, sizeof(address)) != 0)
+			probeError = errno;
+		close(probeFd);
+		if (probeError != ECONNREFUSED) {
+			if (probeError == 0)
+				printf("Error: Socket \"%s\" is already in use.\n", argv[2]);
+			else
+				printf("Error: Socket \"%s\" is already in use: %s\n", argv[2], strerror(probeError));
+			return EXIT_FAILURE;
+		}
+		unlink(argv[2]);
+	}
+
+	state.listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (state.listenFd < 0 || bind(state.listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+		listen(state.listenFd, SOMAXCONN) != 0) {
+		printf("Error: Could not listen on socket \"%s\": %s\n", argv[2], strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	// a client closing its connection early must not end the server
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("Listening on \"%s\" with %d threads.\n", argv[2], numThreads);
+	fflush(stdout);
+
+	std::vector<pthread_t> threads(numThreads);
+	for (int i = 0; i < numThreads; i++) {
+		if (pthread_create(&threads[i], NULL, Worker, &state) != 0) {
+			printf("Error: Could not start thread %d.\n", i + 1);
+			return EXIT_FAILURE;
+		}
+	}
+	for (int i = 0; i < numThreads; i++)
+		pthread_join(threads[i], NULL);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,287 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "Common.h"
+#include "ObservedHotspots.h"
+#include "AbcdSpaceLimits.h"
+#include "PossibleHotspotsDistribution.h"
+#include "LikelihoodCache.h"
+#include "HotspotComparison.h"
+
+// Validates an alternative engine against the reference grid path, which
+// computes the abcd space in chunks of -interval ba values & adds it to
+// every hotspot with CalculateHotspotProbability.  Each observation file of
+// the corpus is run at each of the given resolutions by both, and the
+// maximum absolute & relative deviation of a hotspot, the total variation
+// distance & the difference in nonremovable probability are reported.  The
+// exit status is a failure if any of them is beyond its tolerance.
+//
+// The engines:
+//   memory      chunks of at most -memoryBudget MB, tiled along ca when a
+//               single ba slab is over the budget
+//   cache       the likelihoods stored to & loaded back from a likelihood
+//               cache in a temporary directory
+//   continuous  the cell-integration engine, at its own resolution
+//
+// Engines chosen at compile time, such as the kernel policies, are
+// validated by comparing the output files of two builds with
+// CNmoonmarsCompare.
+
+enum Engine {
+	MemoryEngine,
+	CacheEngine,
+	ContinuousEngine
+};
+
+static const char* EngineNames[] = {"memory", "cache", "continuous"};
+static const int NumEngines = 3;
+
+struct Params {
+	Engine engine;
+	std::vector<int> gridRes;
+	int increment;
+	int interval;
+	int memoryBudget;
+	int cellOrder;
+
+	Double maxAbsError;
+	Double maxRelError;
+	Double maxTotalVariation;
+	Double maxNonremovableDiff;
+
+	std::vector<std::string> corpus;
+};
+
+Params DefaultParams() {
+	Params params;
+
+	params.engine = MemoryEngine;
+	params.increment = 1;
+	params.interval = 1;
+	params.memoryBudget = 1;
+	params.cellOrder = 4;
+
+	params.maxAbsError = 1e-15;
+	params.maxRelError = 1e-9;
+	params.maxTotalVariation = 1e-15;
+	params.maxNonremovableDiff = 1e-15;
+
+	return params;
+}
+
+std::vector<int> ReadIntList(char* argument, std::string argName) {
+	std::vector<int> values;
+	char* end = argument;
+	while (*end != '\0') {
+		char* start = end;
+		long int value = strtol(start, &end, 10);
+		if (end == start || value < 1 || (*end != ',' && *end != '\0')) {
+			printf("Error: Invalid value for argument %s: \"%s\".\n", argName.c_str(), argument);
+			exit(EXIT_FAILURE);
+		}
+		values.push_back(value);
+		if (*end == ',')
+			end++;
+	}
+	return values;
+}
+
+Engine ReadEngine(char* argument) {
+	for (int i = 0; i < NumEngines; i++) {
+		if (strcmp(argument, EngineNames[i]) == 0)
+			return (Engine)i;
+	}
+
+	printf("Error: Unknown engine \"%s\".\n", argument);
+	exit(EXIT_FAILURE);
+}
+
+void ParseArguments(int argc, char* argv[], Params &params) {
+	static struct option long_options[] =
+	{
+		{"engine",						required_argument, NULL, 'n'},
+		{"gridRes",						required_argument, NULL, 'g'},
+		{"increment",					required_argument, NULL, 'c'},
+		{"interval",					required_argument, NULL, 't'},
+		{"memoryBudget",				required_argument, NULL, 'm'},
+		{"cellOrder",					required_argument, NULL, 'o'},
+		{"maxAbsError",					required_argument, NULL, 128},
+		{"maxRelError",					required_argument, NULL, 129},
+		{"maxTotalVariation",			required_argument, NULL, 130},
+		{"maxNonremovableDiff",			required_argument, NULL, 131},
+		{0, 0, 0, 0}
+	};
+
+	int option_index;
+	int c;
+	while ((c = getopt_long_only(argc, argv, "", long_options, &option_index)) != -1) {
+		switch (c)
+		{
+			case 'n': params.engine = ReadEngine(optarg); break;
+			case 'g': params.gridRes = ReadIntList(optarg, "gridRes"); break;
+			case 'c': params.increment = atoi(optarg); break;
+			case 't': params.interval = atoi(optarg); break;
+			case 'm': params.memoryBudget = atoi(optarg); break;
+			case 'o': params.cellOrder = atoi(optarg); break;
+			case 128: params.maxAbsError = strtold(optarg, NULL); break;
+			case 129: params.maxRelError = strtold(optarg, NULL); break;
+			case 130: params.maxTotalVariation = strtold(optarg, NULL); break;
+			case 131: params.maxNonremovableDiff = strtold(optarg, NULL); break;
+			default:
+				printf("Error: Could not parse arguments.\n");
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	for (int i = optind; i < argc; i++)
+		params.corpus.push_back(argv[i]);
+
+	if (params.corpus.empty()) {
+		printf("Usage: ./CNmoonmarsValidate [-engine memory|cache|continuous] [-gridRes 1,2] [-increment n] [-interval n]\n"
+			   "                            [-memoryBudget MB] [-cellOrder n] [-maxAbsError x] [-maxRelError x]\n"
+			   "                            [-maxTotalVariation x] [-maxNonremovableDiff x] observationFile...\n");
+		exit(EXIT_FAILURE);
+	}
+	if (params.gridRes.empty())
+		params.gridRes.push_back(1);
+}
+
+std::vector<HotspotCoordsWithProbability> RunGrid(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits,
+												  LikelihoodCache* cache, int gridRes, const Params &params, int memoryBudget) {
+	PossibleHotspotsDistribution distribution(observedHotspots, limits, NULL, cache, gridRes, params.increment, params.interval,
+											  memoryBudget, true, false, params.cellOrder);
+	return distribution.GetHotspots().ToVector();
+}
+
+void RemoveDirectory(std::string directory) {
+	DIR* dir = opendir(directory.c_str());
+	if (dir != NULL) {
+		struct dirent* entry;
+		while ((entry = readdir(dir)) != NULL) {
+			if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+				unlink((directory + entry->d_name).c_str());
+		}
+		closedir(dir);
+	}
+	rmdir(directory.c_str());
+}
+
+std::vector<HotspotCoordsWithProbability> RunEngine(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits,
+													int gridRes, const Params &params) {
+	switch (params.engine) {
+		case MemoryEngine:
+			return RunGrid(observedHotspots, limits, NULL, gridRes, params, params.memoryBudget);
+
+		case CacheEngine: {
+			char directory[] = "/tmp/CNmoonmarsValidate-XXXXXX";
+			if (mkdtemp(directory) == NULL) {
+				printf("Error: Could not create a temporary likelihood cache directory.\n");
+				exit(EXIT_FAILURE);
+			}
+			std::string cacheDir = std::string(directory) + "/";
+			LikelihoodCache cache(cacheDir, 1L << 40);
+
+			// the first run stores every chunk, and the second loads them
+			RunGrid(observedHotspots, limits, &cache, gridRes, params, 0);
+			int misses = cache.GetNumMisses();
+			std::vector<HotspotCoordsWithProbability> points = RunGrid(observedHotspots, limits, &cache, gridRes, params, 0);
+			RemoveDirectory(cacheDir);
+
+			if (cache.GetNumMisses() != misses) {
+				printf("Error: The likelihood cache did not return every chunk it stored.\n");
+				exit(EXIT_FAILURE);
+			}
+			return points;
+		}
+
+		case ContinuousEngine: {
+			PossibleHotspotsDistribution distribution(observedHotspots, limits, NULL, NULL, gridRes, params.increment, params.interval,
+													  0, true, true, params.cellOrder);
+			return distribution.GetHotspots().ToVector();
+		}
+	}
+
+	return std::vector<HotspotCoordsWithProbability>();
+}
+
+Double NonremovableProbability(std::vector<HotspotCoordsWithProbability>* points, const PossibleHotspotsDistribution &nonremovable) {
+	PossibleHotspotsDistribution distribution(points);
+	return distribution.GetTotalProbability(nonremovable);
+}
+
+struct Result {
+	std::string file;
+	int gridRes;
+	Double maxAbsDev;
+	Double maxRelDev;
+	Double totalVariation;
+	Double nonremovableDiff;
+	bool passed;
+};
+
+int main(int argc, char* argv[]) {
+	Params params = DefaultParams();
+	ParseArguments(argc, argv, params);
+
+	printf("===============================================================\n");
+	printf("Validating the %s engine against the reference grid path.\n\n", EngineNames[params.engine]);
+
+	std::vector<Result> results;
+	for (std::vector<std::string>::iterator file = params.corpus.begin(); file < params.corpus.end(); file++) {
+		ObservedHotspots observedHotspots(*file);
+		observedHotspots.RemoveDuplicates();
+		AbcdSpaceLimits limits(observedHotspots);
+		PossibleHotspotsDistribution nonremovable(limits, true);
+
+		for (std::vector<int>::iterator gridRes = params.gridRes.begin(); gridRes < params.gridRes.end(); gridRes++) {
+			printf("---------------------------------------------------------------\n");
+			printf("\"%s\" at gridRes = %d, reference:\n", file->c_str(), *gridRes);
+			std::vector<HotspotCoordsWithProbability> refPoints = RunGrid(observedHotspots, limits, NULL, *gridRes, params, 0);
+			printf("\n\"%s\" at gridRes = %d, %s engine:\n", file->c_str(), *gridRes, EngineNames[params.engine]);
+			std::vector<HotspotCoordsWithProbability> testPoints = RunEngine(observedHotspots, limits, *gridRes, params);
+			printf("\n");
+
+			HotspotComparison comparison(refPoints, testPoints);
+			if (!comparison.CoordinatesMatch())
+				return EXIT_FAILURE;
+			comparison.Print(testPoints);
+
+			Result result;
+			result.file = *file;
+			result.gridRes = *gridRes;
+			result.maxAbsDev = comparison.GetMaxAbsDev();
+			result.maxRelDev = comparison.GetMaxRelDev();
+			result.totalVariation = comparison.GetTotalVariation();
+			// last, as it frees the points
+			result.nonremovableDiff = fabsl(NonremovableProbability(&testPoints, nonremovable) -
+											NonremovableProbability(&refPoints, nonremovable));
+			printf("Nonremovable probability diff:  %.6Le\n\n", result.nonremovableDiff);
+
+			result.passed = result.maxAbsDev <= params.maxAbsError && result.maxRelDev <= params.maxRelError &&
+							result.totalVariation <= params.maxTotalVariation && result.nonremovableDiff <= params.maxNonremovableDiff;
+			results.push_back(result);
+		}
+	}
+
+	printf("===============================================================\n");
+	printf("Tolerances: %.1Le absolute, %.1Le relative, %.1Le total variation, %.1Le nonremovable\n\n",
+		   params.maxAbsError, params.maxRelError, params.maxTotalVariation, params.maxNonremovableDiff);
+	printf("%-40s%8s%14s%14s%14s%14s%8s\n", "File", "gridRes", "Max abs", "Max rel", "Total var", "Nonremovable", "");
+
+	int numFailed = 0;
+	for (std::vector<Result>::iterator result = results.begin(); result < results.end(); result++) {
+		printf("%-40s%8d%14.3Le%14.3Le%14.3Le%14.3Le%8s\n", result->file.c_str(), result->gridRes, result->maxAbsDev,
+			   result->maxRelDev, result->totalVariation, result->nonremovableDiff, result->passed ? "PASS" : "FAIL");
+		if (!result->passed)
+			numFailed++;
+	}
+
+	printf("\n%d of %d cases passed.\n", (int)results.size() - numFailed, (int)results.size());
+	return numFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -3,9 +3,45 @@
 
 
 #include "HotspotCoordsWithDate.h"
+#include "ScaledDouble.h"
+#include "ExactProduct.h"
 
 typedef long double Double;
 
+// numeric policy of the abcd space likelihood kernel: by default the factors
+// are multiplied in double with a separate exponent per point, while
+// using_long_double_kernel keeps the original Double products, and
+// using_exact_kernel multiplies only the integer overlaps of the factors
+#if defined(using_exact_kernel)
+typedef Double KernelFloat;
+typedef ExactProduct KernelProb;
+#elif defined(using_long_double_kernel)
+typedef Double KernelFloat;
+typedef Double KernelProb;
+#else
+typedef double KernelFloat;
+typedef ScaledDouble KernelProb;
+#endif
+
+#ifdef using_double_abcd_prob
+typedef double AbcdProb;
+#else
+typedef Double AbcdProb;
+#endif
+
+// base^exponent, for an exponent of at least 1, by repeated squaring
+template <class T>
+T IntegerPower(T base, int exponent) {
+	T result = base;
+	for (exponent--; exponent > 0; exponent >>= 1) {
+		if (exponent & 1)
+			result *= base;
+		if (exponent > 1)
+			base *= base;
+	}
+	return result;
+}
+
 void StandardizeDirectoryName(std::string &dirName);
 bool DirectoryExists(const char* dirName);
 
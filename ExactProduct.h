@@ -0,0 +1,55 @@
+#ifndef __EXACT_PRODUCT__
+#define __EXACT_PRODUCT__
+
+
+#include <cmath>
+
+// A product of integer factors kept as a 128-bit integer mantissa with a
+// shared binary exponent.  The mantissa is held below 2^96, so it only ever
+// loses low bits by truncation, and the result of a given sequence of
+// factors is the same bit for bit on every compiler, machine & thread count.
+class ExactProduct {
+public:
+	ExactProduct() : mantissa(0), exponent(0) {}
+	ExactProduct(unsigned int value) : mantissa(value), exponent(0) {}
+
+	ExactProduct& operator*=(unsigned int factor) {
+		mantissa *= factor;
+		unsigned int high = (unsigned int)(mantissa >> 96);
+		if (high != 0) {
+			int shift = 32 - __builtin_clz(high);
+			mantissa >>= shift;
+			exponent += shift;
+		}
+		return *this;
+	}
+
+	// multiplies by factor^count, grouping as many factors as fit in 32 bits
+	// into each multiplication
+	ExactProduct& MultiplyPower(unsigned int factor, int count) {
+		while (count > 0) {
+			unsigned long long group = factor;
+			for (count--; count > 0 && group*factor <= 0xffffffffULL; count--)
+				group *= factor;
+			*this *= (unsigned int)group;
+		}
+		return *this;
+	}
+
+	bool operator==(double value) const {
+		if (value == 0)
+			return mantissa == 0;
+		return (long double)*this == value;
+	}
+
+	operator long double() const {
+		return ldexpl((long double)mantissa, exponent);
+	}
+
+private:
+	unsigned __int128 mantissa;
+	int exponent;
+};
+
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef __FIXED_WIDTH_WRITER__
+#define __FIXED_WIDTH_WRITER__
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const long int WriterSliceRecords = 16384;
+
+inline bool WriteFixedWidthBytes(int fd, const char* bytes, long int numBytes, long int offset) {
+	while (numBytes > 0) {
+		ssize_t written = pwrite(fd, bytes, numBytes, offset);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		bytes += written;
+		numBytes -= written;
+		offset += written;
+	}
+	return true;
+}
+
+// Writes a header followed by numRecords records of exactly recordWidth
+// bytes.  Slices of records are formatted in parallel, each into a buffer
+// of its own thread by formatter.Format(begin, end, buffer), and written
+// with pwrite at the offset that the fixed width gives them.
+template <class Formatter>
+void WriteFixedWidthFile(std::string filename, std::string header, long int numRecords, int recordWidth,
+						 const Formatter &formatter) {
+	int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		printf("Error: Could not open file for writing: \"%s\"\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	bool writeFailed = !WriteFixedWidthBytes(fd, header.c_str(), header.size(), 0);
+	long int numSlices = (numRecords + WriterSliceRecords - 1)/WriterSliceRecords;
+
+	#ifdef using_parallel
+	#pragma omp parallel
+	#endif
+	{
+		std::vector<char> buffer(WriterSliceRecords*recordWidth);
+
+		#ifdef using_parallel
+		#pragma omp for schedule(dynamic)
+		#endif
+		for (long int slice = 0; slice < numSlices; slice++) {
+			long int begin = slice*WriterSliceRecords;
+			long int end = std::min(begin + WriterSliceRecords, numRecords);
+			formatter.Format(begin, end, &buffer[0]);
+			if (!WriteFixedWidthBytes(fd, &buffer[0], (end - begin)*recordWidth, header.size() + begin*recordWidth)) {
+				#ifdef using_parallel
+				#pragma omp atomic write
+				#endif
+				writeFailed = true;
+			}
+		}
+	}
+
+	if(close(fd) != 0 || writeFailed) {
+		printf("Error: Could not write to file: \"%s\"\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Formats value into exactly width bytes of buffer with snprintf, and fails
+// if the format does not produce that width
+template <class Value>
+void FormatFixedWidth(char* buffer, int width, const char* format, Value value) {
+	char field[128];
+	int length = snprintf(field, sizeof(field), format, value);
+	if (length != width) {
+		printf("Error: Formatted \"%s\" to %d characters instead of %d.\n", field, length, width);
+		exit(EXIT_FAILURE);
+	}
+	memcpy(buffer, field, width);
+}
+
+// Writes value right aligned in exactly width bytes of buffer, like "%*d"
+inline void FormatFixedWidthInteger(char* buffer, int width, int value) {
+	bool negative = value < 0;
+	unsigned int magnitude = negative ? -(unsigned int)value : value;
+	int i = width;
+	do {
+		buffer[--i] = '0' + magnitude%10;
+		magnitude /= 10;
+	} while (magnitude > 0 && i > 0);
+	if (magnitude > 0 || (negative && i == 0)) {
+		printf("Error: %d does not fit in %d characters.\n", value, width);
+		exit(EXIT_FAILURE);
+	}
+	if (negative)
+		buffer[--i] = '-';
+	while (i > 0)
+		buffer[--i] = ' ';
+}
+
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef __GRID_SCALE__
+#define __GRID_SCALE__
+
+
+#include "HotspotCoords.h"
+
+// The number of grid points around the circle, and the sizes of the lat &
+// long cells, for a grid resolution known at compile time, so that the
+// kernels instantiated with it divide & wrap by constants.  GridScale<0>
+// holds a resolution given at run time, for those without an instantiation.
+template <int GridRes>
+class GridScale {
+public:
+	GridScale(int) {}
+
+	int LimitCount() const { return HotspotCoords::NumLats*HotspotCoords::NumLongs*GridRes; }
+	int LatScale() const { return HotspotCoords::NumLongs*GridRes; }
+	int LongScale() const { return HotspotCoords::NumLats*GridRes; }
+
+	// brings an offset into [-LimitCount/2, LimitCount - LimitCount/2] the
+	// way repeated wrapping from above or below would, for offsets within
+	// 2*LimitCount of that range
+	int Wrap(int x) const {
+		int limitCount = LimitCount();
+		x = x > limitCount - limitCount/2 ? x - limitCount : x;
+		x = x > limitCount - limitCount/2 ? x - limitCount : x;
+		x = x < -limitCount/2 ? x + limitCount : x;
+		x = x < -limitCount/2 ? x + limitCount : x;
+		return x;
+	}
+};
+
+template <>
+class GridScale<0> {
+public:
+	GridScale(int inGridRes) : limitCount(HotspotCoords::NumLats*HotspotCoords::NumLongs*inGridRes), gridRes(inGridRes) {}
+
+	int LimitCount() const { return limitCount; }
+	int LatScale() const { return HotspotCoords::NumLongs*gridRes; }
+	int LongScale() const { return HotspotCoords::NumLats*gridRes; }
+
+	int Wrap(int x) const {
+		x = x > limitCount - limitCount/2 ? x - limitCount : x;
+		x = x > limitCount - limitCount/2 ? x - limitCount : x;
+		x = x < -limitCount/2 ? x + limitCount : x;
+		x = x < -limitCount/2 ? x + limitCount : x;
+		return x;
+	}
+
+private:
+	int limitCount;
+	int gridRes;
+};
+
+
+#endif
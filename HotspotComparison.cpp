@@ -0,0 +1,90 @@
+#include <cstdio>
+#include <cmath>
+#include "HotspotComparison.h"
+
+HotspotComparison::HotspotComparison(const std::vector<HotspotCoordsWithProbability> &refPoints,
+									 const std::vector<HotspotCoordsWithProbability> &testPoints) :
+	coordinatesMatch(true),
+	numPoints(refPoints.size()),
+	maxAbsDev(0),
+	maxRelDev(0),
+	sumRelDev(0),
+	sumAbsDev(0),
+	maxAbsIndex(-1),
+	maxRelIndex(-1)
+{
+	if (refPoints.size() != testPoints.size()) {
+		printf("Error: Reference has %d hotspots, test has %d.\n", (int)refPoints.size(), (int)testPoints.size());
+		coordinatesMatch = false;
+		return;
+	}
+
+	for (unsigned int i = 0; i < refPoints.size(); i++) {
+		if (refPoints[i].moonLat != testPoints[i].moonLat || refPoints[i].moonLong != testPoints[i].moonLong ||
+			refPoints[i].marsLat != testPoints[i].marsLat || refPoints[i].marsLong != testPoints[i].marsLong) {
+			printf("Error: Hotspot %d differs between the files:\n", i + 1);
+			printf("%s\n%s\n", refPoints[i].ToString().c_str(), testPoints[i].ToString().c_str());
+			coordinatesMatch = false;
+			return;
+		}
+
+		Double absDev = fabsl(testPoints[i].prob - refPoints[i].prob);
+		Double relDev = 0;
+		if (refPoints[i].prob != 0)
+			relDev = absDev/refPoints[i].prob;
+		else if (absDev != 0)
+			relDev = INFINITY;
+
+		sumAbsDev += absDev;
+		sumRelDev += relDev;
+		if (absDev > maxAbsDev || maxAbsIndex < 0) {
+			maxAbsDev = absDev;
+			maxAbsIndex = i;
+		}
+		if (relDev > maxRelDev || maxRelIndex < 0) {
+			maxRelDev = relDev;
+			maxRelIndex = i;
+		}
+	}
+}
+
+bool HotspotComparison::CoordinatesMatch() const {
+	return coordinatesMatch;
+}
+
+Double HotspotComparison::GetMaxAbsDev() const {
+	return maxAbsDev;
+}
+
+Double HotspotComparison::GetMaxRelDev() const {
+	return maxRelDev;
+}
+
+Double HotspotComparison::GetMeanRelDev() const {
+	return numPoints > 0 ? sumRelDev/numPoints : 0;
+}
+
+Double HotspotComparison::GetTotalVariation() const {
+	return sumAbsDev/2;
+}
+
+int HotspotComparison::GetMaxAbsIndex() const {
+	return maxAbsIndex;
+}
+
+int HotspotComparison::GetMaxRelIndex() const {
+	return maxRelIndex;
+}
+
+void HotspotComparison::Print(const std::vector<HotspotCoordsWithProbability> &testPoints) const {
+	printf("Number of hotspots compared:    %d\n\n", numPoints);
+	if (numPoints == 0)
+		return;
+
+	printf("Max absolute deviation:         %.6Le\n", maxAbsDev);
+	printf("%s\n", testPoints[maxAbsIndex].ToString().c_str());
+	printf("Max relative deviation:         %.6Le\n", maxRelDev);
+	printf("%s\n", testPoints[maxRelIndex].ToString().c_str());
+	printf("Mean relative deviation:        %.6Le\n", GetMeanRelDev());
+	printf("Total variation distance:       %.6Le\n", GetTotalVariation());
+}
@@ -0,0 +1,43 @@
+#ifndef __HOTSPOT_COMPARISON__
+#define __HOTSPOT_COMPARISON__
+
+
+#include <string>
+#include <vector>
+#include "Common.h"
+#include "HotspotCoordsWithProbability.h"
+
+// The deviations of a test distribution of possible hotspots from a
+// reference one over the same coordinates, in the same order.
+class HotspotComparison {
+public:
+	HotspotComparison(const std::vector<HotspotCoordsWithProbability> &refPoints,
+					  const std::vector<HotspotCoordsWithProbability> &testPoints);
+
+	// false if the coordinates differ, the first difference having been
+	// printed when comparing
+	bool CoordinatesMatch() const;
+
+	Double GetMaxAbsDev() const;
+	Double GetMaxRelDev() const;
+	Double GetMeanRelDev() const;
+	// half the sum of the absolute deviations
+	Double GetTotalVariation() const;
+	int GetMaxAbsIndex() const;
+	int GetMaxRelIndex() const;
+
+	void Print(const std::vector<HotspotCoordsWithProbability> &testPoints) const;
+
+private:
+	bool coordinatesMatch;
+	int numPoints;
+	Double maxAbsDev;
+	Double maxRelDev;
+	Double sumRelDev;
+	Double sumAbsDev;
+	int maxAbsIndex;
+	int maxRelIndex;
+};
+
+
+#endif
@@ -8,7 +8,7 @@ HotspotCoords::HotspotCoords() :
 	marsLong(MissingCoord) {
 }
 
-Coord* HotspotCoords::GetCoordArray() {
+Coord* HotspotCoords::GetCoordArray() const {
 	Coord* coordArray = new Coord[4];
 	coordArray[0] = moonLat;
 	coordArray[1] = moonLong;
@@ -26,7 +26,7 @@ const short* HotspotCoords::GetNumCoordsArray() {
 	return numCoordsArray;
 }
 
-std::string HotspotCoords::ToString() {
+std::string HotspotCoords::ToString() const {
 	char buff[1024];
 	sprintf(buff, "%6d%6d%6d%6d",
 			moonLat,
@@ -11,9 +11,9 @@ class HotspotCoords {
 public:
 	HotspotCoords();
 	
-	std::string ToString();
+	std::string ToString() const;
 	
-	Coord* GetCoordArray();
+	Coord* GetCoordArray() const;
 	static const short* GetNumCoordsArray();
 	
 	static bool Compare(HotspotCoords a, HotspotCoords b);
@@ -1,7 +1,7 @@
 #include <cstdio>
 #include "HotspotCoordsWithDate.h"
 
-std::string HotspotCoordsWithDate::ToString() {
+std::string HotspotCoordsWithDate::ToString() const {
 	char buff[1024];
 	sprintf(buff, "%5d, %5d, %5d, %5d, %5d, %5d",
 			month.value,
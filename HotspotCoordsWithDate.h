@@ -10,7 +10,7 @@ typedef short Year;
 
 class HotspotCoordsWithDate : public HotspotCoords {
 public:
-	std::string ToString();
+	std::string ToString() const;
 	
 	Month month;
 	Year year;
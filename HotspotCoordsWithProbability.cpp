@@ -1,7 +1,7 @@
 #include <cstdio>
 #include "HotspotCoordsWithProbability.h"
 
-std::string HotspotCoordsWithProbability::ToString() {
+std::string HotspotCoordsWithProbability::ToString() const {
 	char buff[1024];
 	sprintf(buff, "%6d%6d%6d%6d%46.36Le",
 			moonLat,
@@ -7,7 +7,7 @@
 
 class HotspotCoordsWithProbability : public HotspotCoords {
 public:
-	std::string ToString();
+	std::string ToString() const;
 	
 	Double prob;
 };
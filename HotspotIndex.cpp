@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "HotspotIndex.h"
+
+int HotspotIndex::Find(const HotspotCoords &coord) const {
+	if (!IsValid(coord))
+		return -1;
+	
+	unsigned int key = PackKey(coord);
+	unsigned int moonCell = key/NumMarsCells;
+	std::vector<Entry>::const_iterator begin = entries.begin() + moonCellStarts[moonCell];
+	std::vector<Entry>::const_iterator end = entries.begin() + moonCellStarts[moonCell + 1];
+	std::vector<Entry>::const_iterator it = std::lower_bound(begin, end, Entry(key, 0), CompareEntries);
+	
+	if (it == end || it->key != key)
+		return -1;
+	return it->position;
+}
+
+int HotspotIndex::GetNumPoints() const {
+	return entries.size();
+}
+
+bool HotspotIndex::IsValid(const HotspotCoords &coord) {
+	return coord.moonLat >= HotspotCoords::MinLat && coord.moonLat <= HotspotCoords::MaxLat &&
+		   coord.moonLong >= HotspotCoords::MinLong && coord.moonLong <= HotspotCoords::MaxLong &&
+		   coord.marsLat >= HotspotCoords::MinLat && coord.marsLat <= HotspotCoords::MaxLat &&
+		   coord.marsLong >= HotspotCoords::MinLong && coord.marsLong <= HotspotCoords::MaxLong;
+}
+
+unsigned int HotspotIndex::PackKey(const HotspotCoords &coord) {
+	unsigned int moonCell = (coord.moonLat - HotspotCoords::MinLat)*HotspotCoords::NumLongs + (coord.moonLong - HotspotCoords::MinLong);
+	unsigned int marsCell = (coord.marsLat - HotspotCoords::MinLat)*HotspotCoords::NumLongs + (coord.marsLong - HotspotCoords::MinLong);
+	return moonCell*NumMarsCells + marsCell;
+}
+
+HotspotCoords HotspotIndex::UnpackKey(unsigned int key) {
+	unsigned int moonCell = key/NumMarsCells;
+	unsigned int marsCell = key%NumMarsCells;
+	HotspotCoords coord;
+	coord.moonLat = moonCell/HotspotCoords::NumLongs + HotspotCoords::MinLat;
+	coord.moonLong = moonCell%HotspotCoords::NumLongs + HotspotCoords::MinLong;
+	coord.marsLat = marsCell/HotspotCoords::NumLongs + HotspotCoords::MinLat;
+	coord.marsLong = marsCell%HotspotCoords::NumLongs + HotspotCoords::MinLong;
+	return coord;
+}
+
+bool HotspotIndex::CompareEntries(const Entry &a, const Entry &b) {
+	return a.key < b.key;
+}
+
+void HotspotIndex::Add(const HotspotCoords &coord, int position) {
+	if (!IsValid(coord)) {
+		printf("Error: Hotspot %d has coordinates out of range: (%d, %d, %d, %d)\n", position + 1,
+			   coord.moonLat, coord.moonLong, coord.marsLat, coord.marsLong);
+		exit(EXIT_FAILURE);
+	}
+	entries.push_back(Entry(PackKey(coord), position));
+}
+
+void HotspotIndex::Build() {
+	std::sort(entries.begin(), entries.end(), CompareEntries);
+	
+	for (unsigned int i = 1; i < entries.size(); i++) {
+		if (entries[i].key == entries[i-1].key) {
+			printf("Error: Hotspots %d & %d have the same coordinates.\n",
+				   std::min(entries[i-1].position, entries[i].position) + 1,
+				   std::max(entries[i-1].position, entries[i].position) + 1);
+			exit(EXIT_FAILURE);
+		}
+	}
+	
+	moonCellStarts.assign(NumMoonCells + 1, 0);
+	for (std::vector<Entry>::iterator it = entries.begin(); it < entries.end(); it++)
+		moonCellStarts[it->key/NumMarsCells + 1]++;
+	for (unsigned int i = 0; i < NumMoonCells; i++)
+		moonCellStarts[i + 1] += moonCellStarts[i];
+}
@@ -0,0 +1,51 @@
+#ifndef __HOTSPOT_INDEX__
+#define __HOTSPOT_INDEX__
+
+
+#include <vector>
+#include "HotspotCoords.h"
+
+// Maps the coordinates of a list of hotspots to their positions in the list.
+// Each hotspot is packed into a 32-bit key, the keys are sorted, and a table
+// of the moon cells points to the few keys sharing each moon location.
+class HotspotIndex {
+public:
+	template <class Hotspot>
+	HotspotIndex(const std::vector<Hotspot> &points) {
+		for (unsigned int i = 0; i < points.size(); i++)
+			Add(points[i], i);
+		Build();
+	}
+	
+	int Find(const HotspotCoords &coord) const;
+	int GetNumPoints() const;
+	
+	static bool IsValid(const HotspotCoords &coord);
+	static unsigned int PackKey(const HotspotCoords &coord);
+	static HotspotCoords UnpackKey(unsigned int key);
+	
+	static const unsigned int NumMarsCells = HotspotCoords::NumLats*HotspotCoords::NumLongs;
+	static const unsigned int NumMoonCells = HotspotCoords::NumLats*HotspotCoords::NumLongs;
+	
+private:
+	struct Entry {
+		unsigned int key;
+		int position;
+		
+		Entry(unsigned int inKey, int inPosition){
+			key = inKey;
+			position = inPosition;
+		}
+	};
+	
+	static bool CompareEntries(const Entry &a, const Entry &b);
+	
+	void Add(const HotspotCoords &coord, int position);
+	void Build();
+	
+	std::vector<Entry> entries;
+	std::vector<int> moonCellStarts;
+};
+
+
+#endif
@@ -0,0 +1,102 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include "InformationGain.h"
+#include "PossibleHotspotsDistribution.h"
+#include "ObservationTable.h"
+#include "ReproducibleSum.h"
+
+// the evidence of the candidates, as terms of a ReproducibleSum
+struct CandidateEvidence {
+	const std::vector<AbcdSpaceProbabilityDistribution::ObservationTerms>* terms;
+
+	CandidateEvidence(const std::vector<AbcdSpaceProbabilityDistribution::ObservationTerms>* inTerms) : terms(inTerms) {}
+
+	Double operator[](long int i) const {
+		return (*terms)[i].evidence;
+	}
+};
+
+InformationGain::InformationGain(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, LikelihoodCache* cache,
+								 int gridRes, int increment, int interval, int memoryBudget) {
+	PossibleHotspotsDistribution possibleHotspots(limits, false);
+	const PackedHotspots &hotspots = possibleHotspots.GetHotspots();
+	candidates.reserve(hotspots.Size());
+	for (long int i = 0; i < hotspots.Size(); i++)
+		candidates.push_back(hotspots.GetCoords(i));
+	terms.resize(candidates.size());
+
+	AbcdSpaceLimitsInt abcdSpaceLimits = limits.GenerateAbcdSpaceLimitsInt(gridRes);
+	ObservationTable observations(observedHotspots, abcdSpaceLimits, gridRes);
+
+	std::vector<AbcdSpaceLimitsInt> chunks;
+	PossibleHotspotsDistribution::PlanChunks(abcdSpaceLimits, gridRes, increment, interval, memoryBudget, &chunks);
+	fflush(stdout);
+
+	long int pointCount = 0;
+	for (std::vector<AbcdSpaceLimitsInt>::iterator chunk = chunks.begin(); chunk < chunks.end(); chunk++) {
+		AbcdSpaceProbabilityDistribution abcdDistribution(observations, *chunk, gridRes, increment, false, cache);
+		abcdDistribution.AccumulateObservations(candidates, &prior, &terms);
+		pointCount += abcdDistribution.GetNumPoints();
+	}
+	printf("Accumulated the posteriors of %d candidate hotspots over %ld points in %d chunks.\n",
+		   (int)candidates.size(), pointCount, (int)chunks.size());
+
+	totalEvidence = ReproducibleSum(CandidateEvidence(&terms), terms.size());
+	if (prior.evidence == 0 || totalEvidence == 0) {
+		printf("Error: The abcd distribution has no probability, or none at the possible hotspots.\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// of the weights normalized to sum to 1, from their sum S & the sum T of
+// weight*log(weight): log(S) - T/S
+Double InformationGain::Entropy(const ObservationTerms &terms) {
+	return (logl(terms.evidence) - terms.weightedLog/terms.evidence)/logl(2.0L);
+}
+
+Double InformationGain::GetPriorEntropy() const {
+	return Entropy(prior);
+}
+
+Double InformationGain::GetExpectedGain() const {
+	Double priorEntropy = GetPriorEntropy();
+	Double gain = 0;
+	for (unsigned int i = 0; i < terms.size(); i++) {
+		if (terms[i].evidence != 0)
+			gain += terms[i].evidence/totalEvidence*(priorEntropy - Entropy(terms[i]));
+	}
+	return gain;
+}
+
+void InformationGain::PrintToFile(std::string filename) {
+	FILE* file = fopen(filename.c_str(), "w");
+	if(!file) {
+		printf("Error: Could not open file for writing: \"%s\"\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	// a candidate without evidence cannot be observed, & is left at zero
+	Double priorEntropy = GetPriorEntropy();
+	Double expectedLeft = 0;
+	for (unsigned int i = 0; i < candidates.size(); i++) {
+		Double prob = terms[i].evidence/totalEvidence;
+		Double reduction = 0;
+		Double left = 0;
+		if (terms[i].evidence != 0) {
+			reduction = priorEntropy - Entropy(terms[i]);
+			left = (Double)terms[i].support/prior.support;
+		}
+		expectedLeft += prob*left;
+
+		fprintf(file, "%6d%6d%6d%6d%46.36Le%24.15Le%24.15Le\n", candidates[i].moonLat, candidates[i].moonLong,
+				candidates[i].marsLat, candidates[i].marsLong, prob, reduction, left);
+	}
+
+	fclose(file);
+
+	printf("Printed the lookahead of %d candidate hotspots to file: \"%s\".\n\n", (int)candidates.size(), filename.c_str());
+	printf("Prior entropy of the abcd space (bits):       %.15Lg\n", priorEntropy);
+	printf("Expected information gain (bits):             %.15Lg\n", GetExpectedGain());
+	printf("Expected fraction of abcd space points left:  %.15Lg\n", expectedLeft);
+}
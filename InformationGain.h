@@ -0,0 +1,45 @@
+#ifndef __INFORMATION_GAIN__
+#define __INFORMATION_GAIN__
+
+
+#include <string>
+#include <vector>
+#include "Common.h"
+#include "ObservedHotspots.h"
+#include "AbcdSpaceLimits.h"
+#include "AbcdSpaceProbabilityDistribution.h"
+#include "LikelihoodCache.h"
+
+// What observing each possible hotspot next month would tell about the
+// abcd space, for choosing which to test next.  Observing a hotspot weighs
+// each point by its overlap with it, so one sweep over the points of each
+// chunk gives every candidate's evidence, the entropy of the posterior it
+// leaves, & the points left with a weight.  The expected information gain
+// is the entropy reduction averaged over the candidates, as weighted by
+// their evidence, which is their probability in the possible hotspots.
+class InformationGain {
+public:
+	InformationGain(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, LikelihoodCache* cache,
+					int gridRes, int increment, int interval, int memoryBudget);
+
+	// the probability, entropy reduction in bits & fraction of the points
+	// left of each candidate, in coordinate order
+	void PrintToFile(std::string filename);
+
+	Double GetPriorEntropy() const;
+	Double GetExpectedGain() const;
+
+private:
+	typedef AbcdSpaceProbabilityDistribution::ObservationTerms ObservationTerms;
+
+	// in bits
+	static Double Entropy(const ObservationTerms &terms);
+
+	std::vector<HotspotCoords> candidates;
+	std::vector<ObservationTerms> terms;
+	ObservationTerms prior;
+	Double totalEvidence;
+};
+
+
+#endif
@@ -0,0 +1,201 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "LikelihoodCache.h"
+
+const char* LikelihoodCache::FileExtension = ".lkc";
+const char* LikelihoodCache::TempSuffix = ".tmp-";
+
+// the kernel policy the likelihoods were computed with, as in Common.h
+#if defined(using_exact_kernel)
+static const int KernelPolicy = 2;
+#elif defined(using_long_double_kernel)
+static const int KernelPolicy = 1;
+#else
+static const int KernelPolicy = 0;
+#endif
+
+LikelihoodCache::LikelihoodCache(std::string inDirectory, long int inMaxBytes) {
+	directory = inDirectory;
+	maxBytes = inMaxBytes;
+	knownBytes = 0;
+	numHits = 0;
+	numMisses = 0;
+
+	if(!DirectoryExists(directory.c_str())) {
+		printf("Error: Likelihood cache directory does not exist: \"%s\"\n", directory.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	Evict();
+}
+
+std::string LikelihoodCache::GetDirectory() const {
+	return directory;
+}
+
+int LikelihoodCache::GetNumHits() const {
+	return numHits;
+}
+
+int LikelihoodCache::GetNumMisses() const {
+	return numMisses;
+}
+
+void LikelihoodCache::FillHeader(const Key &key, long int numPoints, Header* header) const {
+	// cleared first, so that the padding hashes & compares the same
+	memset(header, 0, sizeof(Header));
+	memcpy(header->magic, "CNmmLKC1", sizeof(header->magic));
+	header->kernelPolicy = KernelPolicy;
+	header->probSize = sizeof(AbcdProb);
+	header->numPoints = numPoints;
+	header->key.observationsDigest = key.observationsDigest;
+	header->key.gridRes = key.gridRes;
+	header->key.increment = key.increment;
+	header->key.limits = key.limits;
+}
+
+std::string LikelihoodCache::GetFilename(const Header &header) const {
+	// 64-bit FNV-1a hash of the header
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned char* bytes = (const unsigned char*)&header;
+	for (unsigned int i = 0; i < sizeof(Header); i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	char buff[32];
+	sprintf(buff, "%016llx", hash);
+	return directory + buff + FileExtension;
+}
+
+bool LikelihoodCache::Load(const Key &key, AbcdProb* probs, long int numPoints) {
+	Header header;
+	FillHeader(key, numPoints, &header);
+	std::string filename = GetFilename(header);
+	long int fileSize = sizeof(Header) + numPoints*sizeof(AbcdProb);
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		numMisses++;
+		return false;
+	}
+
+	struct stat sb;
+	void* data = MAP_FAILED;
+	if (fstat(fd, &sb) == 0 && sb.st_size == fileSize)
+		data = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	// a file whose key differs only shares the hash, & is left to eviction
+	bool found = data != MAP_FAILED && memcmp(data, &header, sizeof(Header)) == 0;
+	if (found)
+		memcpy(probs, (const char*)data + sizeof(Header), numPoints*sizeof(AbcdProb));
+	if (data != MAP_FAILED)
+		munmap(data, fileSize);
+
+	if (!found) {
+		numMisses++;
+		return false;
+	}
+
+	utimes(filename.c_str(), NULL);
+	numHits++;
+	return true;
+}
+
+void LikelihoodCache::Store(const Key &key, const AbcdProb* probs, long int numPoints) {
+	Header header;
+	FillHeader(key, numPoints, &header);
+	std::string filename = GetFilename(header);
+	long int fileSize = sizeof(Header) + numPoints*sizeof(AbcdProb);
+	if (fileSize > maxBytes)
+		return;
+
+	// shards sharing the directory may store the same chunk at once, so
+	// each writes a file of its own and renames it over the others
+	char host[256] = "";
+	gethostname(host, sizeof(host) - 1);
+	char suffix[320];
+	sprintf(suffix, "%s%s-%d", TempSuffix, host, (int)getpid());
+	std::string tmpFilename = filename + suffix;
+
+	FILE* file = fopen(tmpFilename.c_str(), "wb");
+	if (!file) {
+		printf("Warning: Could not write to likelihood cache: \"%s\"\n", tmpFilename.c_str());
+		return;
+	}
+	bool written = fwrite(&header, sizeof(Header), 1, file) == 1 &&
+				   fwrite(probs, sizeof(AbcdProb), numPoints, file) == (size_t)numPoints;
+	if (fclose(file) != 0 || !written || rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+		printf("Warning: Could not write to likelihood cache: \"%s\"\n", filename.c_str());
+		unlink(tmpFilename.c_str());
+		return;
+	}
+
+	// a file replacing another is counted twice, which only scans sooner
+	knownBytes += fileSize;
+	if (knownBytes > maxBytes)
+		Evict();
+}
+
+bool LikelihoodCache::CompareLastUsed(const CacheFile &a, const CacheFile &b) {
+	if (a.lastUsed != b.lastUsed)
+		return a.lastUsed < b.lastUsed;
+	return a.name < b.name;
+}
+
+void LikelihoodCache::Evict() {
+	DIR* dir = opendir(directory.c_str());
+	if (!dir)
+		return;
+
+	std::vector<CacheFile> files;
+	long int totalBytes = 0;
+	std::string extension = FileExtension;
+	std::string tempInfix = extension + TempSuffix;
+	time_t now = time(NULL);
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		std::string name = entry->d_name;
+		bool isTemp = name.find(tempInfix) != std::string::npos;
+		if (!isTemp && (name.size() <= extension.size() ||
+						name.compare(name.size() - extension.size(), extension.size(), extension) != 0))
+			continue;
+
+		struct stat sb;
+		if (stat((directory + name).c_str(), &sb) != 0)
+			continue;
+
+		// a temporary file still being written counts, but is not evicted
+		if (isTemp) {
+			if (now - sb.st_mtime > StaleTempSeconds && unlink((directory + name).c_str()) == 0)
+				continue;
+			totalBytes += sb.st_size;
+			continue;
+		}
+
+		CacheFile file;
+		file.name = name;
+		file.size = sb.st_size;
+		file.lastUsed = sb.st_mtim.tv_sec*1000000000LL + sb.st_mtim.tv_nsec;
+		files.push_back(file);
+		totalBytes += file.size;
+	}
+	closedir(dir);
+
+	std::sort(files.begin(), files.end(), CompareLastUsed);
+	for (std::vector<CacheFile>::iterator it = files.begin(); it != files.end() && totalBytes > maxBytes; ++it) {
+		if (unlink((directory + it->name).c_str()) == 0)
+			totalBytes -= it->size;
+	}
+	knownBytes = totalBytes;
+}
@@ -0,0 +1,75 @@
+#ifndef __LIKELIHOOD_CACHE__
+#define __LIKELIHOOD_CACHE__
+
+
+#include <string>
+#include <vector>
+#include "Common.h"
+#include "AbcdSpaceLimitsInt.h"
+
+// An on-disk cache of the abcd space likelihoods of each chunk, shared by
+// every run & shard that points at the same directory.  Each chunk is a
+// file named by a hash of its key, holding a header with the key and then
+// the raw AbcdProb array, which is mapped into memory to load it.  Files
+// are written under a temporary name and renamed into place, loading one
+// touches its modification time, and the least recently used files are
+// removed whenever the cache grows beyond its size.  The size is tracked as
+// files are stored, and the directory is only scanned when it is exceeded;
+// the scan also removes the temporary files of writers that were killed.
+class LikelihoodCache {
+public:
+	struct Key {
+		unsigned long long observationsDigest;
+		int gridRes;
+		int increment;
+		AbcdSpaceLimitsInt limits;
+	};
+
+	LikelihoodCache(std::string directory, long int maxBytes);
+
+	bool Load(const Key &key, AbcdProb* probs, long int numPoints);
+	void Store(const Key &key, const AbcdProb* probs, long int numPoints);
+
+	std::string GetDirectory() const;
+	int GetNumHits() const;
+	int GetNumMisses() const;
+
+	static const char* FileExtension;
+	// added to a file's name while it is written
+	static const char* TempSuffix;
+	// a temporary file untouched for longer is left by a killed writer
+	static const int StaleTempSeconds = 3600;
+
+private:
+	struct Header {
+		char magic[8];
+		int kernelPolicy;
+		int probSize;
+		long int numPoints;
+		Key key;
+	};
+
+	struct CacheFile {
+		std::string name;
+		long int size;
+		// modification time in nanoseconds
+		long long lastUsed;
+	};
+
+	static bool CompareLastUsed(const CacheFile &a, const CacheFile &b);
+
+	void FillHeader(const Key &key, long int numPoints, Header* header) const;
+	std::string GetFilename(const Header &header) const;
+	void Evict();
+
+	std::string directory;
+	long int maxBytes;
+	// of the files in the directory as of the last scan, plus those stored
+	// since
+	long int knownBytes;
+	int numHits;
+	int numMisses;
+};
+
+
+#endif
@@ -0,0 +1,145 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Manifest.h"
+#include "Sha256.h"
+
+const char* Manifest::Magic = "CNMOONMARS MANIFEST 1";
+
+Manifest::Manifest() {
+}
+
+Manifest::Manifest(std::string filename) {
+	FILE* file = fopen(filename.c_str(), "r");
+	if(!file) {
+		printf("Error: Could not open file for reading: \"%s\"\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	char line[4096];
+	if(fgets(line, sizeof(line), file) == NULL || strncmp(line, Magic, strlen(Magic)) != 0) {
+		printf("Error: Not a manifest file: \"%s\"\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	int lineNum = 1;
+	while(fgets(line, sizeof(line), file) != NULL) {
+		lineNum++;
+		char kind[16], first[1024], second[1024];
+		long int size;
+		int length = 0;
+
+		if(sscanf(line, "PARAM %1023s %1023s", first, second) == 2) {
+			SetParameter(first, second);
+		} else if(sscanf(line, "FILE %1023s %ld %n", first, &size, &length) == 2 && length > 0) {
+			// the name is the rest of the line, & may hold spaces
+			std::string name = line + length;
+			while(!name.empty() && (name[name.size()-1] == '\n' || name[name.size()-1] == '\r'))
+				name.erase(name.size()-1);
+
+			FileEntry entry;
+			entry.name = name;
+			entry.digest = first;
+			entry.size = size;
+			files.push_back(entry);
+		} else if(sscanf(line, "%15s", kind) == 1) {
+			printf("Error: Could not read line %d of manifest file: \"%s\"\n", lineNum, filename.c_str());
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	fclose(file);
+}
+
+void Manifest::SetParameter(std::string name, std::string value) {
+	for (std::vector<Parameter>::iterator it = parameters.begin(); it < parameters.end(); it++) {
+		if (it->name == name) {
+			it->value = value;
+			return;
+		}
+	}
+
+	Parameter parameter;
+	parameter.name = name;
+	parameter.value = value;
+	parameters.push_back(parameter);
+}
+
+void Manifest::SetParameter(std::string name, int value) {
+	char buff[32];
+	sprintf(buff, "%d", value);
+	SetParameter(name, std::string(buff));
+}
+
+void Manifest::SetHotspots(const PackedHotspots &hotspots) {
+	Sha256 digest;
+	for (long int i = 0; i < hotspots.Size(); i++) {
+		HotspotCoords coord = hotspots.GetCoords(i);
+		char buff[32];
+		int length = sprintf(buff, "%6d%6d%6d%6d\n", coord.moonLat, coord.moonLong, coord.marsLat, coord.marsLong);
+		digest.Update(buff, length);
+	}
+
+	SetParameter("hotspotCount", (int)hotspots.Size());
+	SetParameter("hotspotDigest", digest.Final());
+}
+
+void Manifest::AddFile(std::string directory, std::string name) {
+	FileEntry entry;
+	entry.name = name;
+	entry.digest = Sha256::DigestFile(directory + name, &entry.size);
+	files.push_back(entry);
+}
+
+std::string Manifest::GetParameter(std::string name) const {
+	for (std::vector<Parameter>::const_iterator it = parameters.begin(); it < parameters.end(); it++) {
+		if (it->name == name)
+			return it->value;
+	}
+	return "";
+}
+
+const Manifest::FileEntry* Manifest::FindFile(std::string name) const {
+	for (std::vector<FileEntry>::const_iterator it = files.begin(); it < files.end(); it++) {
+		if (it->name == name)
+			return &(*it);
+	}
+	return NULL;
+}
+
+std::string Manifest::GetDigest(std::string name) const {
+	const FileEntry* entry = FindFile(name);
+	return entry != NULL ? entry->digest : "";
+}
+
+long int Manifest::GetSize(std::string name) const {
+	const FileEntry* entry = FindFile(name);
+	return entry != NULL ? entry->size : 0;
+}
+
+bool Manifest::HasFile(std::string name) const {
+	return FindFile(name) != NULL;
+}
+
+void Manifest::PrintToFile(std::string filename) {
+	// written under a temporary name & renamed into place, so that a
+	// manifest that exists is always complete
+	std::string tmpFilename = filename + ".tmp";
+	FILE* file = fopen(tmpFilename.c_str(), "w");
+	if(!file) {
+		printf("Error: Could not open file for writing: \"%s\"\n", tmpFilename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(file, "%s\n", Magic);
+	for (std::vector<Parameter>::iterator it = parameters.begin(); it < parameters.end(); it++)
+		fprintf(file, "PARAM %s %s\n", it->name.c_str(), it->value.c_str());
+	for (std::vector<FileEntry>::iterator it = files.begin(); it < files.end(); it++)
+		fprintf(file, "FILE %s %ld %s\n", it->digest.c_str(), it->size, it->name.c_str());
+
+	if(fclose(file) != 0 || rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+		printf("Error: Could not write manifest file: \"%s\"\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	printf("Printed manifest to file: \"%s\".\n", filename.c_str());
+}
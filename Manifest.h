@@ -0,0 +1,52 @@
+#ifndef __MANIFEST__
+#define __MANIFEST__
+
+
+#include <string>
+#include <vector>
+#include "PackedHotspots.h"
+
+// The SHA-256 digest & size of each output file of a run, with the run
+// parameters and the digest of its list of possible hotspot coordinates.
+// The reassembler verifies that the shards agree by comparing manifests,
+// instead of reading the files themselves.
+class Manifest {
+public:
+	Manifest();
+	Manifest(std::string filename);
+
+	void SetParameter(std::string name, std::string value);
+	void SetParameter(std::string name, int value);
+	void SetHotspots(const PackedHotspots &hotspots);
+	void AddFile(std::string directory, std::string name);
+
+	// an empty string if the manifest has no such parameter or file
+	std::string GetParameter(std::string name) const;
+	std::string GetDigest(std::string name) const;
+	long int GetSize(std::string name) const;
+	bool HasFile(std::string name) const;
+
+	void PrintToFile(std::string filename);
+
+	static const char* Magic;
+
+private:
+	struct Parameter {
+		std::string name;
+		std::string value;
+	};
+
+	struct FileEntry {
+		std::string name;
+		std::string digest;
+		long int size;
+	};
+
+	const FileEntry* FindFile(std::string name) const;
+
+	std::vector<Parameter> parameters;
+	std::vector<FileEntry> files;
+};
+
+
+#endif
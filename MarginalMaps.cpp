@@ -0,0 +1,87 @@
+#include <cstdio>
+#include <cstdlib>
+#include "MarginalMaps.h"
+#include "AbcdSpaceProbabilityDistribution.h"
+#include "PossibleHotspotsDistribution.h"
+#include "ObservationTable.h"
+#include "ReproducibleSum.h"
+
+MarginalMaps::MarginalMaps(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, LikelihoodCache* cache,
+						   int gridRes, int increment, int interval, int memoryBudget, const HotspotCoords &givenMoon) :
+	moonCells(NumCells, 0),
+	marsCells(NumCells, 0)
+{
+	bool conditional = givenMoon.moonLat != HotspotCoords::MissingCoord;
+	if (conditional && (givenMoon.moonLat < HotspotCoords::MinLat || givenMoon.moonLat > HotspotCoords::MaxLat ||
+						givenMoon.moonLong < HotspotCoords::MinLong || givenMoon.moonLong > HotspotCoords::MaxLong)) {
+		printf("Error: The given moon location is out of range: (%d, %d)\n", givenMoon.moonLat, givenMoon.moonLong);
+		exit(EXIT_FAILURE);
+	}
+	
+	AbcdSpaceLimitsInt abcdSpaceLimits = limits.GenerateAbcdSpaceLimitsInt(gridRes);
+	ObservationTable observations(observedHotspots, abcdSpaceLimits, gridRes);
+	
+	std::vector<AbcdSpaceLimitsInt> chunks;
+	PossibleHotspotsDistribution::PlanChunks(abcdSpaceLimits, gridRes, increment, interval, memoryBudget, &chunks);
+	fflush(stdout);
+	
+	long int pointCount = 0;
+	for (std::vector<AbcdSpaceLimitsInt>::iterator chunk = chunks.begin(); chunk < chunks.end(); chunk++) {
+		AbcdSpaceProbabilityDistribution abcdDistribution(observations, *chunk, gridRes, increment, false, cache);
+		if (conditional) {
+			abcdDistribution.AccumulateConditionalMarsMarginal(givenMoon, &marsCells);
+		} else {
+			abcdDistribution.AccumulateMoonMarginal(&moonCells);
+			abcdDistribution.AccumulateMarsMarginal(&marsCells);
+		}
+		pointCount += abcdDistribution.GetNumPoints();
+	}
+	if (conditional) {
+		printf("Accumulated the mars marginal given the moon at (%d, %d) over %ld points in %d chunks.\n",
+			   givenMoon.moonLat, givenMoon.moonLong, pointCount, (int)chunks.size());
+	} else {
+		printf("Accumulated the moon & mars marginals over %ld points in %d chunks.\n", pointCount, (int)chunks.size());
+		Normalize(&moonCells);
+	}
+	Normalize(&marsCells);
+}
+
+void MarginalMaps::Normalize(std::vector<Double>* cells) {
+	Double sumProb = ReproducibleSum(*cells, cells->size());
+	if (sumProb == 0) {
+		printf("Error: The abcd distribution has no probability, or none at the given moon location.\n");
+		exit(EXIT_FAILURE);
+	}
+	for (std::vector<Double>::iterator cell = cells->begin(); cell < cells->end(); cell++)
+		*cell /= sumProb;
+}
+
+void MarginalMaps::PrintMoonToFile(std::string filename) {
+	PrintToFile(filename, moonCells, "moon");
+}
+
+void MarginalMaps::PrintMarsToFile(std::string filename) {
+	PrintToFile(filename, marsCells, "mars");
+}
+
+// prints the cells with nonzero probability, in coordinate order
+void MarginalMaps::PrintToFile(std::string filename, const std::vector<Double> &cells, const char* body) {
+	FILE* file = fopen(filename.c_str(), "w");
+	if(!file) {
+		printf("Error: Could not open file for writing: \"%s\"\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	int count = 0;
+	for (int i = 0; i < NumCells; i++) {
+		if (cells[i] == 0)
+			continue;
+		fprintf(file, "%6d%6d%46.36Le\n", HotspotCoords::MinLat + i/HotspotCoords::NumLongs,
+				HotspotCoords::MinLong + i%HotspotCoords::NumLongs, cells[i]);
+		count++;
+	}
+	
+	fclose(file);
+	
+	printf("Printed %d %s locations to file: \"%s\".\n", count, body, filename.c_str());
+}
@@ -0,0 +1,37 @@
+#ifndef __MARGINAL_MAPS__
+#define __MARGINAL_MAPS__
+
+
+#include <string>
+#include <vector>
+#include "Common.h"
+#include "ObservedHotspots.h"
+#include "AbcdSpaceLimits.h"
+#include "LikelihoodCache.h"
+
+// The probability of each moon location & of each mars location next month,
+// accumulated directly from the abcd distribution of each chunk, without
+// the possible hotspots: the moon location depends only on ba, and the mars
+// location only on da - ca, so each is a one dimensional scatter.  Given
+// the moon location, the mars map is instead conditioned on it, filtering
+// the points by their overlap with the moon cell, & the moon map is unused.
+class MarginalMaps {
+public:
+	MarginalMaps(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, LikelihoodCache* cache,
+				 int gridRes, int increment, int interval, int memoryBudget, const HotspotCoords &givenMoon = HotspotCoords());
+	
+	void PrintMoonToFile(std::string filename);
+	void PrintMarsToFile(std::string filename);
+	
+	static const int NumCells = HotspotCoords::NumLats*HotspotCoords::NumLongs;
+	
+private:
+	void Normalize(std::vector<Double>* cells);
+	void PrintToFile(std::string filename, const std::vector<Double> &cells, const char* body);
+	
+	std::vector<Double> moonCells;
+	std::vector<Double> marsCells;
+};
+
+
+#endif
@@ -32,3 +32,9 @@ void Month::Set(std::string str) {
 	printf("Invalid month string: %s\n", str.c_str());
 	exit(EXIT_FAILURE);
 }
+
+std::string Month::ToString() const {
+	static const char* names[13] = {"???", "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+									"Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+	return names[value];
+}
@@ -10,6 +10,7 @@ public:
 	Month(std::string str);
 	
 	void Set(std::string str);
+	std::string ToString() const;
 	
 	enum MonthEnum { Invalid = 0,
 		Jan = 1, Feb = 2,  Mar = 3,  Apr = 4, 
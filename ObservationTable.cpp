@@ -0,0 +1,208 @@
+#include <cstdio>
+#include <cstdlib>
+#include "ObservationTable.h"
+#include "ThreadPlacement.h"
+
+bool ObservationTable::replicatePerSocket = false;
+
+ObservationTable::ObservationTable(const ObservedHotspots &observedHotspots, const AbcdSpaceLimitsInt &limits, int inGridRes) {
+	gridRes = inGridRes;
+	LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*gridRes;
+	latScale = LimitCount/HotspotCoords::NumLats;
+	longScale = LimitCount/HotspotCoords::NumLongs;
+	numObservations = 0;
+	digest = 14695981039346656037ULL;
+
+	ConstraintCompiler compiler;
+	compiler.table = this;
+	observedHotspots.Visit(compiler);
+
+	MeasureSelectivity(limits);
+	BuildRuns();
+	if (replicatePerSocket)
+		Replicate();
+}
+
+ObservationTable::ObservationTable(const ObservationTable &other) :
+	constraints(other.constraints),
+	runs(other.runs),
+	numObservations(other.numObservations),
+	digest(other.digest),
+	gridRes(other.gridRes),
+	LimitCount(other.LimitCount),
+	latScale(other.latScale),
+	longScale(other.longScale)
+{
+}
+
+ObservationTable::~ObservationTable() {
+	for (unsigned int i = 0; i < replicas.size(); i++)
+		delete replicas[i];
+}
+
+void ObservationTable::SetReplicatePerSocket(bool replicate) {
+	replicatePerSocket = replicate;
+}
+
+const ObservationTable &ObservationTable::GetLocalTable() const {
+	if (replicas.empty())
+		return *this;
+	const ObservationTable* replica = replicas[GetCurrentSocket()];
+	return replica != NULL ? *replica : *this;
+}
+
+// each copy is made by the first thread found on its socket, whose
+// allocations are placed there
+void ObservationTable::Replicate() {
+	int numSockets = GetNumSockets();
+	if (numSockets <= 1)
+		return;
+	replicas.resize(numSockets, NULL);
+
+	#ifdef using_parallel
+	#pragma omp parallel
+	#endif
+	{
+		int socket = GetCurrentSocket();
+		#ifdef using_parallel
+		#pragma omp critical
+		#endif
+		{
+			if (replicas[socket] == NULL)
+				replicas[socket] = new ObservationTable(*this);
+		}
+	}
+}
+
+int ObservationTable::GetNumObservations() const {
+	return numObservations;
+}
+
+unsigned long long ObservationTable::GetDigest() const {
+	return digest;
+}
+
+int ObservationTable::GetNumConstraints() const {
+	return constraints.size();
+}
+
+int ObservationTable::GetNumRuns() const {
+	return runs.size();
+}
+
+void ObservationTable::ConstraintCompiler::operator()(const HotspotCoordsWithDate &coord) {
+	table->AddConstraint(coord);
+}
+
+void ObservationTable::AddConstraint(const HotspotCoordsWithDate &coord) {
+	if (coord.moonLat == HotspotCoords::MissingCoord) {
+		printf("Error: coord.moonLat is missing!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Constraint constraint;
+	constraint.mask = 0;
+	constraint.multiplicity = 1;
+	constraint.zeroCount = 0;
+	constraint.order = constraints.size();
+
+	int a = coord.moonLat*latScale;
+	Coord coords[3] = {coord.moonLong, coord.marsLat, coord.marsLong};
+	int scales[3] = {longScale, latScale, longScale};
+	for (int i = 0; i < 3; i++) {
+		constraint.lows[i] = 0;
+		if (coords[i] == HotspotCoords::MissingCoord)
+			continue;
+
+		constraint.mask |= 1 << i;
+		constraint.lows[i] = coords[i]*scales[i] - scales[i]/2 - a;
+		if (constraint.lows[i] < -LimitCount || constraint.lows[i] + scales[i] > LimitCount) {
+			printf("Error: Observation %s is outside the coordinate range.\n", coord.ToString().c_str());
+			exit(EXIT_FAILURE);
+		}
+	}
+	numObservations++;
+
+	// 64-bit FNV-1a over the coordinates
+	Coord allCoords[4] = {coord.moonLat, coord.moonLong, coord.marsLat, coord.marsLong};
+	for (int i = 0; i < 4; i++) {
+		for (unsigned int j = 0; j < sizeof(Coord); j++) {
+			digest ^= (allCoords[i] >> (8*j)) & 0xff;
+			digest *= 1099511628211ULL;
+		}
+	}
+
+	for (std::vector<Constraint>::iterator other = constraints.begin(); other != constraints.end(); ++other) {
+		if (other->mask == constraint.mask && other->lows[0] == constraint.lows[0] &&
+			other->lows[1] == constraint.lows[1] && other->lows[2] == constraint.lows[2]) {
+			other->multiplicity++;
+			return;
+		}
+	}
+	constraints.push_back(constraint);
+}
+
+int ObservationTable::MeasureWidth(const Constraint &constraint, int ba, int ca, int da) const {
+	GridScale<0> scale(gridRes);
+	switch (constraint.mask) {
+		case 0: return Width<0>(scale, constraint, ba, ca, da);
+		case 1: return Width<1>(scale, constraint, ba, ca, da);
+		case 2: return Width<2>(scale, constraint, ba, ca, da);
+		case 3: return Width<3>(scale, constraint, ba, ca, da);
+		case 4: return Width<4>(scale, constraint, ba, ca, da);
+		case 5: return Width<5>(scale, constraint, ba, ca, da);
+		case 6: return Width<6>(scale, constraint, ba, ca, da);
+		default: return Width<7>(scale, constraint, ba, ca, da);
+	}
+}
+
+// counts how many points of a lattice of about SampleSteps^3 points spread
+// over the abcd space each constraint zeroes, and sorts the constraints so
+// that the most selective ones are evaluated first
+void ObservationTable::MeasureSelectivity(const AbcdSpaceLimitsInt &limsInt) {
+	int mins[3], maxs[3], steps[3];
+	for (int i = 0; i < 3; i++) {
+		mins[i] = LimitCount - limsInt.limits[0][i+1];
+		maxs[i] = limsInt.limits[i+1][0];
+		if (mins[i] < 0 || maxs[i] > LimitCount) {
+			printf("Error: Abcd space limits are outside [0, %d].\n", LimitCount);
+			exit(EXIT_FAILURE);
+		}
+		steps[i] = std::max(1, (maxs[i] - mins[i])/SampleSteps);
+	}
+
+	for (int ba = mins[0] + steps[0]/2 + 1; ba < maxs[0]; ba += steps[0]) {
+		for (int ca = mins[1] + steps[1]/2 + 1; ca < maxs[1]; ca += steps[1]) {
+			for (int da = mins[2] + steps[2]/2 + 1; da < maxs[2]; da += steps[2]) {
+				if (ca-ba > LimitCount - limsInt.limits[1][2] && ca-ba < limsInt.limits[2][1] &&
+					da-ba > LimitCount - limsInt.limits[1][3] && da-ba < limsInt.limits[3][1] &&
+					da-ca > LimitCount - limsInt.limits[2][3] && da-ca < limsInt.limits[3][2]) {
+					for (std::vector<Constraint>::iterator it = constraints.begin(); it != constraints.end(); ++it) {
+						if (MeasureWidth(*it, ba, ca, da) <= 0)
+							it->zeroCount++;
+					}
+				}
+			}
+		}
+	}
+
+	std::sort(constraints.begin(), constraints.end(), CompareSelectivity);
+}
+
+bool ObservationTable::CompareSelectivity(const Constraint &a, const Constraint &b) {
+	if (a.zeroCount != b.zeroCount)
+		return a.zeroCount > b.zeroCount;
+	return a.order < b.order;
+}
+
+void ObservationTable::BuildRuns() {
+	for (unsigned int i = 0; i < constraints.size(); i++) {
+		if (runs.empty() || runs.back().mask != constraints[i].mask) {
+			Run run;
+			run.mask = constraints[i].mask;
+			run.begin = i;
+			runs.push_back(run);
+		}
+		runs.back().end = i + 1;
+	}
+}
@@ -0,0 +1,151 @@
+#ifndef __OBSERVATION_TABLE__
+#define __OBSERVATION_TABLE__
+
+
+#include <algorithm>
+#include <vector>
+#include "Common.h"
+#include "ObservedHotspots.h"
+#include "AbcdSpaceLimitsInt.h"
+#include "GridScale.h"
+
+// The observations compiled once for the grid likelihood kernel.  Each
+// observation becomes a constraint holding the offsets of its coordinates
+// from its moon latitude, scaled to the grid, and a mask of the coordinates
+// it has.  Identical constraints are merged into one with a multiplicity,
+// the constraints are ordered by how often they zero the points of a sample
+// of the abcd space, and consecutive constraints with the same mask form
+// runs that a kernel specialized for that mask evaluates.
+class ObservationTable {
+public:
+	ObservationTable(const ObservedHotspots &observedHotspots, const AbcdSpaceLimitsInt &limits, int gridRes);
+	// copies all but the replicas
+	ObservationTable(const ObservationTable &other);
+	~ObservationTable();
+
+	// whether the tables constructed after are copied to each socket, so
+	// that the kernel's threads read the table from their own socket's
+	// memory; they are read for every point
+	static void SetReplicatePerSocket(bool replicate);
+	// the copy on the calling thread's socket, or the table itself
+	const ObservationTable &GetLocalTable() const;
+
+	// calls multiplier(width, multiplicity) with the overlap of each
+	// constraint with the point, and returns false as soon as one is empty;
+	// scale is the GridScale of the gridRes the table was compiled for
+	template <class Scale, class Multiplier>
+	bool Multiply(const Scale &scale, int ba, int ca, int da, Multiplier &multiplier) const {
+		for (std::vector<Run>::const_iterator run = runs.begin(); run != runs.end(); ++run) {
+			bool nonzero = true;
+			switch (run->mask) {
+				case 0: nonzero = MultiplyRun<0>(scale, *run, ba, ca, da, multiplier); break;
+				case 1: nonzero = MultiplyRun<1>(scale, *run, ba, ca, da, multiplier); break;
+				case 2: nonzero = MultiplyRun<2>(scale, *run, ba, ca, da, multiplier); break;
+				case 3: nonzero = MultiplyRun<3>(scale, *run, ba, ca, da, multiplier); break;
+				case 4: nonzero = MultiplyRun<4>(scale, *run, ba, ca, da, multiplier); break;
+				case 5: nonzero = MultiplyRun<5>(scale, *run, ba, ca, da, multiplier); break;
+				case 6: nonzero = MultiplyRun<6>(scale, *run, ba, ca, da, multiplier); break;
+				case 7: nonzero = MultiplyRun<7>(scale, *run, ba, ca, da, multiplier); break;
+			}
+			if (!nonzero)
+				return false;
+		}
+		return true;
+	}
+
+	int GetNumObservations() const;
+	unsigned long long GetDigest() const;
+	int GetNumConstraints() const;
+	int GetNumRuns() const;
+
+	// bits of the mask, one for each coordinate besides the moon latitude
+	static const int MoonLongBit = 1;
+	static const int MarsLatBit = 2;
+	static const int MarsLongBit = 4;
+
+	static const int SampleSteps = 16;
+
+private:
+	struct Constraint {
+		int mask;
+		int multiplicity;
+
+		// lower edge of the moon longitude, mars latitude & mars longitude
+		// cells, relative to the moon latitude
+		int lows[3];
+
+		int zeroCount;
+		int order;
+	};
+
+	struct Run {
+		int mask;
+		int begin;
+		int end;
+	};
+
+	struct ConstraintCompiler {
+		ObservationTable* table;
+
+		void operator()(const HotspotCoordsWithDate &coord);
+	};
+
+	static bool CompareSelectivity(const Constraint &a, const Constraint &b);
+
+	ObservationTable &operator=(const ObservationTable &other);
+
+	void AddConstraint(const HotspotCoordsWithDate &coord);
+	void MeasureSelectivity(const AbcdSpaceLimitsInt &limsInt);
+	void BuildRuns();
+	void Replicate();
+	int MeasureWidth(const Constraint &constraint, int ba, int ca, int da) const;
+
+	template <int Mask, class Scale>
+	static inline int Width(const Scale &scale, const Constraint &constraint, int ba, int ca, int da) {
+		int xmin = -scale.LatScale()/2;
+		int xmax = scale.LatScale() - scale.LatScale()/2;
+		if (Mask & MoonLongBit) {
+			xmin = std::max(xmin, scale.Wrap(constraint.lows[0] - ba));
+			xmax = std::min(xmax, scale.Wrap(constraint.lows[0] + scale.LongScale() - ba));
+		}
+		if (Mask & MarsLatBit) {
+			xmin = std::max(xmin, scale.Wrap(constraint.lows[1] - ca));
+			xmax = std::min(xmax, scale.Wrap(constraint.lows[1] + scale.LatScale() - ca));
+		}
+		if (Mask & MarsLongBit) {
+			xmin = std::max(xmin, scale.Wrap(constraint.lows[2] - da));
+			xmax = std::min(xmax, scale.Wrap(constraint.lows[2] + scale.LongScale() - da));
+		}
+		return xmax - xmin;
+	}
+
+	template <int Mask, class Scale, class Multiplier>
+	inline bool MultiplyRun(const Scale &scale, const Run &run, int ba, int ca, int da, Multiplier &multiplier) const {
+		for (int i = run.begin; i < run.end; i++) {
+			const Constraint &constraint = constraints[i];
+			int width = Width<Mask>(scale, constraint, ba, ca, da);
+			if (width <= 0)
+				return false;
+			multiplier(width, constraint.multiplicity);
+		}
+		return true;
+	}
+
+	std::vector<Constraint> constraints;
+	std::vector<Run> runs;
+	int numObservations;
+
+	// hash of the coordinates of the observations, in order
+	unsigned long long digest;
+	int gridRes;
+	int LimitCount;
+	int latScale;
+	int longScale;
+
+	// indexed by socket, NULL for sockets no thread ran on
+	std::vector<ObservationTable*> replicas;
+	static bool replicatePerSocket;
+};
+
+
+#endif
@@ -44,14 +44,16 @@ ObservedHotspots::ObservedHotspots(std::string filename) {
 	fclose(file);
 }
 
+ObservedHotspots::ObservedHotspots(const std::vector<HotspotCoordsWithDate> &observations) :
+	observedHotspots(observations)
+{
+}
+
 ObservedHotspots::~ObservedHotspots() {
 }
 
-void ObservedHotspots::Iterate(void (*function)(HotspotCoordsWithDate coord, void* data), void* data){
-	std::vector<HotspotCoordsWithDate>::iterator it;
-	for (it = observedHotspots.begin(); it != observedHotspots.end(); ++it) {
-		function(*it, data);
-	}
+int ObservedHotspots::GetNumObservations() const {
+	return observedHotspots.size();
 }
 
 void ObservedHotspots::RemoveDuplicates() {
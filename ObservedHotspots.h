@@ -10,13 +10,28 @@
 class ObservedHotspots {
 public:
 	ObservedHotspots(std::string filename);
+	ObservedHotspots(const std::vector<HotspotCoordsWithDate> &observations);
 	~ObservedHotspots();
 	
-	void Iterate(void (*function)(HotspotCoordsWithDate coord, void* data), void* data);
+	// calls visitor(coord) with each observation in turn, and is expanded
+	// inline wherever it is used
+	template <class Visitor>
+	void Visit(Visitor &visitor) const {
+		std::vector<HotspotCoordsWithDate>::const_iterator it;
+		for (it = observedHotspots.begin(); it != observedHotspots.end(); ++it) {
+			visitor(*it);
+		}
+	}
 	
 	void RemoveDuplicates();
 	
+	int GetNumObservations() const;
+	
 private:
+	// the observations are owned by a single object, passed by reference
+	ObservedHotspots(const ObservedHotspots &other);
+	ObservedHotspots& operator=(const ObservedHotspots &other);
+	
 	Coord ScanCoordinate(FILE* file);
 	
 	std::vector <HotspotCoordsWithDate> observedHotspots;
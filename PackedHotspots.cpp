@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "PackedHotspots.h"
+#include "HotspotIndex.h"
+
+PackedHotspots::PackedHotspots() :
+	sorted(true)
+{
+}
+
+PackedHotspots::PackedHotspots(const std::vector<HotspotCoordsWithProbability> &points) :
+	sorted(true)
+{
+	Reserve(points.size());
+	for (std::vector<HotspotCoordsWithProbability>::const_iterator it = points.begin(); it < points.end(); it++)
+		Add(*it, it->prob);
+}
+
+void PackedHotspots::Add(const HotspotCoords &coord, Double prob) {
+	if (!HotspotIndex::IsValid(coord)) {
+		printf("Error: Hotspot %ld has coordinates out of range: (%d, %d, %d, %d)\n", Size() + 1,
+			   coord.moonLat, coord.moonLong, coord.marsLat, coord.marsLong);
+		exit(EXIT_FAILURE);
+	}
+
+	unsigned int key = HotspotIndex::PackKey(coord);
+	if (!keys.empty() && key <= keys.back())
+		sorted = false;
+	keys.push_back(key);
+	probs.push_back(PackedProb());
+	SetProb(keys.size() - 1, prob);
+}
+
+void PackedHotspots::Reserve(long int count) {
+	keys.reserve(count);
+	probs.reserve(count);
+}
+
+void PackedHotspots::Clear() {
+	// swapped with empty arrays, to free their memory
+	std::vector<unsigned int>().swap(keys);
+	std::vector<PackedProb>().swap(probs);
+	sorted = true;
+}
+
+void PackedHotspots::Swap(PackedHotspots &other) {
+	keys.swap(other.keys);
+	probs.swap(other.probs);
+	std::swap(sorted, other.sorted);
+}
+
+long int PackedHotspots::Size() const {
+	return keys.size();
+}
+
+HotspotCoords PackedHotspots::GetCoords(long int i) const {
+	return HotspotIndex::UnpackKey(keys[i]);
+}
+
+HotspotCoordsWithProbability PackedHotspots::operator[](long int i) const {
+	HotspotCoordsWithProbability point;
+	HotspotCoords coord = GetCoords(i);
+	point.moonLat = coord.moonLat;
+	point.moonLong = coord.moonLong;
+	point.marsLat = coord.marsLat;
+	point.marsLong = coord.marsLong;
+	point.prob = Prob(i);
+	return point;
+}
+
+std::vector<HotspotCoordsWithProbability> PackedHotspots::ToVector() const {
+	std::vector<HotspotCoordsWithProbability> points(Size());
+	for (long int i = 0; i < Size(); i++)
+		points[i] = (*this)[i];
+	return points;
+}
+
+int PackedHotspots::Find(const HotspotCoords &coord) const {
+	if (!sorted) {
+		printf("Error: Hotspots not in coordinate order cannot be searched.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (!HotspotIndex::IsValid(coord))
+		return -1;
+
+	unsigned int key = HotspotIndex::PackKey(coord);
+	std::vector<unsigned int>::const_iterator it = std::lower_bound(keys.begin(), keys.end(), key);
+	if (it == keys.end() || *it != key)
+		return -1;
+	return it - keys.begin();
+}
+
+bool PackedHotspots::IsSorted() const {
+	return sorted;
+}
+
+long int PackedHotspots::HotspotBytes() {
+	return sizeof(unsigned int) + sizeof(PackedProb);
+}
@@ -0,0 +1,66 @@
+#ifndef __PACKED_HOTSPOTS__
+#define __PACKED_HOTSPOTS__
+
+
+#include <vector>
+#include <cfloat>
+#include <cstring>
+#include "Common.h"
+#include "HotspotCoords.h"
+#include "HotspotCoordsWithProbability.h"
+
+// A list of hotspots as two parallel arrays: the coordinates of each packed
+// into a 32-bit key by HotspotIndex::PackKey, and its probability.  An x87
+// long double holds 10 significant bytes padded to 16, so only those 10 are
+// stored, unpadded; that is 14 bytes a hotspot, where a
+// HotspotCoordsWithProbability takes 32.  The keys of hotspots added in
+// coordinate order are sorted, so that they can be found by a binary search
+// without an index.
+class PackedHotspots {
+public:
+	PackedHotspots();
+	PackedHotspots(const std::vector<HotspotCoordsWithProbability> &points);
+
+	void Add(const HotspotCoords &coord, Double prob = 0);
+	void Reserve(long int count);
+	void Clear();
+	void Swap(PackedHotspots &other);
+
+	long int Size() const;
+	HotspotCoords GetCoords(long int i) const;
+	Double Prob(long int i) const {
+		Double prob = 0;
+		memcpy(&prob, probs[i].bytes, ProbBytes);
+		return prob;
+	}
+	void SetProb(long int i, Double prob) {
+		memcpy(probs[i].bytes, &prob, ProbBytes);
+	}
+	// a copy of the hotspot, for reading
+	HotspotCoordsWithProbability operator[](long int i) const;
+
+	std::vector<HotspotCoordsWithProbability> ToVector() const;
+
+	// the memory each hotspot takes
+	static long int HotspotBytes();
+
+	// the position of the hotspot, or -1; the keys must be sorted
+	int Find(const HotspotCoords &coord) const;
+	bool IsSorted() const;
+
+private:
+	// the significant bytes of a Double: the 64-bit mantissa, sign &
+	// exponent of an x87 long double, or all of any other
+	static const int ProbBytes = LDBL_MANT_DIG == 64 && sizeof(Double) >= 10 ? 10 : sizeof(Double);
+
+	struct PackedProb {
+		unsigned char bytes[ProbBytes];
+	};
+
+	std::vector<unsigned int> keys;
+	std::vector<PackedProb> probs;
+	bool sorted;
+};
+
+
+#endif
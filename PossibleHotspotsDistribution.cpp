@@ -3,13 +3,39 @@
 #include <cmath>
 #include <ctime>
 #include "PossibleHotspotsDistribution.h"
+#include "ReproducibleSum.h"
+#include "FixedWidthWriter.h"
+
+// the probabilities of a hotspot list, as terms of a ReproducibleSum
+struct HotspotProbabilities {
+	const std::vector<HotspotCoordsWithProbability>* points;
+	
+	HotspotProbabilities(const std::vector<HotspotCoordsWithProbability>* inPoints) : points(inPoints) {}
+	
+	Double operator[](long int i) const {
+		return (*points)[i].prob;
+	}
+};
+
+// the probabilities of packed hotspots, as terms of a ReproducibleSum
+struct PackedProbabilities {
+	const PackedHotspots* points;
+	
+	PackedProbabilities(const PackedHotspots* inPoints) : points(inPoints) {}
+	
+	Double operator[](long int i) const {
+		return points->Prob(i);
+	}
+};
 
 PossibleHotspotsDistribution::PossibleHotspotsDistribution(std::vector<HotspotCoordsWithProbability>* points) :
 startIndex(0),
 endIndex(0)
 {
 	ValidateIndexLimits(startIndex, endIndex);
-	possibleHotspots = *points;
+	PackedHotspots packed(*points);
+	possibleHotspots.Swap(packed);
+	std::vector<HotspotCoordsWithProbability>().swap(*points);
 }
 
 PossibleHotspotsDistribution::PossibleHotspotsDistribution(int inStartIndex, int inEndIndex) :
@@ -19,7 +45,7 @@ PossibleHotspotsDistribution::PossibleHotspotsDistribution(int inStartIndex, int
 	ValidateIndexLimits(startIndex, endIndex);
 }
 
-PossibleHotspotsDistribution::PossibleHotspotsDistribution(AbcdSpaceLimits limits, bool nonremovable) :
+PossibleHotspotsDistribution::PossibleHotspotsDistribution(const AbcdSpaceLimits &limits, bool nonremovable) :
 startIndex(0),
 endIndex(0)
 {
@@ -27,26 +53,126 @@ endIndex(0)
 	CalculatePossibleHotspotCoords(limits, nonremovable);
 }
 
-PossibleHotspotsDistribution::PossibleHotspotsDistribution(ObservedHotspots observedHotspots, AbcdSpaceLimits limits, RegenerateMatrix* regenMat,
-							int inGridRes, int inIncrement, int inInterval, bool inDedupObserved, std::string directory,
-							int inStartIndex, int inEndIndex) :
+PossibleHotspotsDistribution::PossibleHotspotsDistribution(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, RegenerateMatrix* regenMat,
+							LikelihoodCache* inCache, int inGridRes, int inIncrement, int inInterval, int inMemoryBudget, bool inDedupObserved, bool inContinuous, int inCellOrder,
+							std::string directory, int inStartIndex, int inEndIndex) :
 	startIndex(inStartIndex),
 	endIndex(inEndIndex),
 	gridRes(inGridRes),
 	increment(inIncrement),
 	interval(inInterval),
-	dedupObserved(inDedupObserved)
+	memoryBudget(inMemoryBudget),
+	dedupObserved(inDedupObserved),
+	continuous(inContinuous),
+	cellOrder(inCellOrder),
+	topK(0),
+	cache(inCache)
 {
 	ValidateIndexLimits(startIndex, endIndex);
 	CalculatePossibleHotspotCoords(limits);
+	if (regenMat != NULL)
+		regenMat->MatchHotspots(possibleHotspots);
 	
+	if (continuous)
+		CalculateContinuousProbabilities(observedHotspots, limits, regenMat, directory);
+	else
+		CalculateGridProbabilities(observedHotspots, limits, regenMat, directory);
+	
+	if (!IsPartial()) {
+		if (regenMat != NULL) {
+			regenMat->RegenerateProbabilities(possibleHotspots);
+		}
+		Normalize();
+	}
+}
+
+PossibleHotspotsDistribution::PossibleHotspotsDistribution(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, RegenerateMatrix* regenMat,
+							LikelihoodCache* inCache, int inGridRes, int inIncrement, int inInterval, int inMemoryBudget, int inTopK) :
+	startIndex(0),
+	endIndex(0),
+	gridRes(inGridRes),
+	increment(inIncrement),
+	interval(inInterval),
+	memoryBudget(inMemoryBudget),
+	dedupObserved(false),
+	continuous(false),
+	cellOrder(0),
+	topK(inTopK),
+	cache(inCache)
+{
+	ValidateIndexLimits(startIndex, endIndex);
+	if (topK < 1) {
+		printf("Error: The number of top hotspots must be at least 1.\n");
+		exit(EXIT_FAILURE);
+	}
+	CalculatePossibleHotspotCoords(limits);
+	CalculateTopProbabilities(observedHotspots, limits, regenMat);
+}
+
+void PossibleHotspotsDistribution::CalculateGridProbabilities(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, 
+															  RegenerateMatrix* regenMat, std::string directory) {
 	long int preCalcNumPoints = AbcdSpaceProbabilityDistribution::CalculateNumberOfAbcdPoints(limits, gridRes, increment);
 	printf("Precomputed number of abcd space points: %ld.\n\n", preCalcNumPoints);
 	
-	int LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*gridRes;
-	
 	AbcdSpaceLimitsInt abcdSpaceLimits = limits.GenerateAbcdSpaceLimitsInt(gridRes);
 	
+	ObservationTable observations(observedHotspots, abcdSpaceLimits, gridRes);
+	printf("Compiled %d observations into %d constraints in %d runs.\n\n", observations.GetNumObservations(),
+		   observations.GetNumConstraints(), observations.GetNumRuns());
+	
+	std::vector<AbcdSpaceLimitsInt> chunks;
+	if (memoryBudget > 0)
+		PlanChunksByMemory(abcdSpaceLimits, &chunks);
+	else
+		PlanChunksByInterval(abcdSpaceLimits, &chunks);
+	int numChunks = chunks.size();
+	
+	fflush(stdout);
+	
+	int chunkCount = 0;
+	long int pointCount = 0;
+	int cacheHits = cache != NULL ? cache->GetNumHits() : 0;
+	for (std::vector<AbcdSpaceLimitsInt>::iterator chunk = chunks.begin(); chunk < chunks.end(); chunk++) {
+		AbcdSpaceProbabilityDistribution* abcdDistribution;
+		abcdDistribution = new AbcdSpaceProbabilityDistribution(observations, *chunk, gridRes, increment, false, cache);
+		AccumulateProbabilities(abcdDistribution, regenMat);
+		
+		pointCount += abcdDistribution->GetNumPoints();
+		chunkCount ++;
+		
+		PrintChunkStatus(chunkCount, numChunks, abcdDistribution->GetNumPoints(), abcdDistribution->GetNumNonzeroPoints(),
+						 pointCount, directory);
+		
+		delete(abcdDistribution);
+	}
+	printf("\nTotal points in the probability distribution: %ld.\n", pointCount);
+	if (cache != NULL)
+		printf("Chunks loaded from the likelihood cache: %d of %d.\n", cache->GetNumHits() - cacheHits, numChunks);
+	
+	if (pointCount != preCalcNumPoints) {
+		printf("!!! ERROR: PRECOMPUTED POINT COUNT, %ld, DOES NOT MATCH ACTUAL POINT COUNT, %ld !!!\n\n", 
+			   preCalcNumPoints, pointCount);
+	}
+}
+
+// the chunks a grid run over the limits computes one at a time
+void PossibleHotspotsDistribution::PlanChunks(const AbcdSpaceLimitsInt &abcdSpaceLimits, int gridRes, int increment, int interval,
+											  int memoryBudget, std::vector<AbcdSpaceLimitsInt>* chunks) {
+	PossibleHotspotsDistribution planner(0, 0);
+	planner.gridRes = gridRes;
+	planner.increment = increment;
+	planner.interval = interval;
+	planner.memoryBudget = memoryBudget;
+	
+	if (memoryBudget > 0)
+		planner.PlanChunksByMemory(abcdSpaceLimits, chunks);
+	else
+		planner.PlanChunksByInterval(abcdSpaceLimits, chunks);
+}
+
+void PossibleHotspotsDistribution::PlanChunksByInterval(const AbcdSpaceLimitsInt &abcdSpaceLimits, std::vector<AbcdSpaceLimitsInt>* chunks) {
+	int LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*gridRes;
+	
 	int minBa = LimitCount - abcdSpaceLimits.limits[0][1];
 	int maxBa = abcdSpaceLimits.limits[1][0];
 	int numChunks = ceil((Double)((maxBa - minBa - 1)/increment)/interval);
@@ -54,59 +180,453 @@ PossibleHotspotsDistribution::PossibleHotspotsDistribution(ObservedHotspots obse
 	AbcdSpaceLimitsInt partialSpaceLimits = abcdSpaceLimits;
 	partialSpaceLimits.limits[1][0] = LimitCount - partialSpaceLimits.limits[0][1] + increment*interval + 1;
 	
+	while (LimitCount - partialSpaceLimits.limits[0][1] + increment < maxBa) {
+		if(partialSpaceLimits.limits[1][0] > maxBa)
+			partialSpaceLimits.limits[1][0] = maxBa;
+		
+		chunks->push_back(partialSpaceLimits);
+		
+		partialSpaceLimits.limits[1][0]+=increment*interval;
+		partialSpaceLimits.limits[0][1]-=increment*interval;
+	}
+	
+	if ((int)chunks->size() != numChunks) {
+		printf("!!! ERROR: PRECOMPUTED CHUNK COUNT, %d, DOES NOT MATCH ACTUAL CHUNK COUNT, %d !!!\n\n", 
+			   numChunks, (int)chunks->size());
+	}
+}
+
+void PossibleHotspotsDistribution::PlanChunksByMemory(const AbcdSpaceLimitsInt &abcdSpaceLimits, std::vector<AbcdSpaceLimitsInt>* chunks) {
+	int LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*gridRes;
+	long int budget = (long int)memoryBudget*1024*1024;
+	
+	// memory needed by each single ba slab of grid points
+	int minBa = LimitCount - abcdSpaceLimits.limits[0][1];
+	int numBa = (abcdSpaceLimits.limits[1][0] - minBa - 1)/increment;
+	std::vector<long int> slabSizes;
+	for (int i = 1; i <= numBa; i++) {
+		AbcdSpaceLimitsInt slab = abcdSpaceLimits;
+		SliceLimits(&slab, 1, i, i);
+		slabSizes.push_back(AbcdSpaceProbabilityDistribution::CalculateMemoryUsage(slab, gridRes, increment));
+	}
+	
+	std::vector<int> slabStarts;
+	BalanceChunks(slabSizes, budget, &slabStarts);
+	
+	long int maxChunkSize = 0;
+	for (unsigned int j = 0; j < slabStarts.size(); j++) {
+		int first = slabStarts[j];
+		int last = (j + 1 < slabStarts.size() ? slabStarts[j+1] : numBa) - 1;
+		
+		AbcdSpaceLimitsInt chunk = abcdSpaceLimits;
+		SliceLimits(&chunk, 1, first + 1, last + 1);
+		
+		if (first < last || slabSizes[first] <= budget) {
+			long int chunkSize = 0;
+			for (int i = first; i <= last; i++)
+				chunkSize += slabSizes[i];
+			maxChunkSize = std::max(maxChunkSize, chunkSize);
+			chunks->push_back(chunk);
+			continue;
+		}
+		
+		// a single ba slab is over the budget, so tile it along ca
+		int minCa = LimitCount - abcdSpaceLimits.limits[0][2];
+		int numCa = (abcdSpaceLimits.limits[2][0] - minCa - 1)/increment;
+		std::vector<long int> rowSizes;
+		for (int i = 1; i <= numCa; i++) {
+			AbcdSpaceLimitsInt row = chunk;
+			SliceLimits(&row, 2, i, i);
+			rowSizes.push_back(AbcdSpaceProbabilityDistribution::CalculateMemoryUsage(row, gridRes, increment));
+		}
+		
+		std::vector<int> tileStarts;
+		BalanceChunks(rowSizes, budget, &tileStarts);
+		
+		for (unsigned int k = 0; k < tileStarts.size(); k++) {
+			int firstCa = tileStarts[k];
+			int lastCa = (k + 1 < tileStarts.size() ? tileStarts[k+1] : numCa) - 1;
+			
+			long int tileSize = 0;
+			for (int i = firstCa; i <= lastCa; i++)
+				tileSize += rowSizes[i];
+			if (tileSize == 0)
+				continue;
+			maxChunkSize = std::max(maxChunkSize, tileSize);
+			
+			AbcdSpaceLimitsInt tile = chunk;
+			SliceLimits(&tile, 2, firstCa + 1, lastCa + 1);
+			chunks->push_back(tile);
+		}
+	}
+	
+	printf("Memory budget of %d MB split the abcd space into %d chunks of at most %.1f MB.\n\n",
+		   memoryBudget, (int)chunks->size(), maxChunkSize/(1024.0*1024.0));
+	if (maxChunkSize > budget) {
+		printf("Warning: A single row of abcd space points needs %.1f MB, which exceeds the memory budget.\n\n",
+			   maxChunkSize/(1024.0*1024.0));
+	}
+}
+
+void PossibleHotspotsDistribution::SliceLimits(AbcdSpaceLimitsInt* limits, int index, int first, int last) {
+	// restricts coordinate index (1 = ba, 2 = ca) to the grid points from
+	// the first to the last increment above the current lower limit
+	int LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*gridRes;
+	int min = LimitCount - limits->limits[0][index];
+	limits->limits[0][index] = LimitCount - (min + (first - 1)*increment);
+	limits->limits[index][0] = min + last*increment + 1;
+}
+
+void PossibleHotspotsDistribution::BalanceChunks(const std::vector<long int> &sizes, long int budget, std::vector<int>* starts) {
+	// find the fewest chunks of consecutive sizes that fit the budget, then
+	// the smallest cap that keeps that many chunks, so they come out even;
+	// a size over the budget always gets a chunk of its own
+	int numChunks = GreedyChunks(sizes, budget, NULL);
+	long int low = 0;
+	long int high = budget;
+	while (high - low > 1) {
+		long int cap = low + (high - low)/2;
+		if (GreedyChunks(sizes, cap, NULL) <= numChunks)
+			high = cap;
+		else
+			low = cap;
+	}
+	GreedyChunks(sizes, high, starts);
+}
+
+int PossibleHotspotsDistribution::GreedyChunks(const std::vector<long int> &sizes, long int cap, std::vector<int>* starts) {
+	int numChunks = 0;
+	long int current = 0;
+	for (unsigned int i = 0; i < sizes.size(); i++) {
+		if (i == 0 || current + sizes[i] > cap) {
+			numChunks++;
+			current = 0;
+			if (starts != NULL)
+				starts->push_back(i);
+		}
+		current += sizes[i];
+	}
+	return numChunks;
+}
+
+void PossibleHotspotsDistribution::CalculateContinuousProbabilities(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, 
+																	RegenerateMatrix* regenMat, std::string directory) {
+	int cellRes = AbcdSpaceContinuousDistribution::CellRes;
+	int LimitCount = HotspotCoords::NumLats*HotspotCoords::NumLongs*cellRes;
+	
+	AbcdSpaceLimitsInt abcdSpaceLimits = limits.GenerateAbcdSpaceLimitsInt(cellRes);
+	
+	// chunks are slabs of interval lattice cubes along ba
+	int minBa = LimitCount - abcdSpaceLimits.limits[0][1];
+	int maxBa = abcdSpaceLimits.limits[1][0];
+	int numChunks = ceil((Double)(maxBa - minBa)/interval);
+	
+	AbcdSpaceLimitsInt partialSpaceLimits = abcdSpaceLimits;
+	partialSpaceLimits.limits[1][0] = minBa + interval;
+	
 	fflush(stdout);
 	
 	int chunkCount = 0;
-	long int pointCount = 0;
-	while (LimitCount - partialSpaceLimits.limits[0][1] + increment < maxBa) {
+	long int cellCount = 0;
+	long int nonzeroCellCount = 0;
+	while (LimitCount - partialSpaceLimits.limits[0][1] < maxBa) {
 		if(partialSpaceLimits.limits[1][0] > maxBa)
 			partialSpaceLimits.limits[1][0] = maxBa;
 		
-		AbcdSpaceProbabilityDistribution* abcdDistribution;
-		abcdDistribution = new AbcdSpaceProbabilityDistribution(observedHotspots, partialSpaceLimits, gridRes, increment, false);
+		AbcdSpaceContinuousDistribution* abcdDistribution;
+		abcdDistribution = new AbcdSpaceContinuousDistribution(observedHotspots, partialSpaceLimits, cellOrder);
 		AccumulateProbabilities(abcdDistribution, regenMat);
 		
-		pointCount += abcdDistribution->GetNumPoints();
+		cellCount += abcdDistribution->GetNumCandidateCells();
+		nonzeroCellCount += abcdDistribution->GetNumCells();
 		chunkCount ++;
 		
-		time_t now = time(0);
-		struct std::tm* tstruct = localtime(&now);
-		char timebuff[512];
-		strftime(timebuff, sizeof(timebuff), "%a %F %T UTC%z", tstruct);
-		
-		char buff[1024];
-		sprintf(buff, "Chunk %5d of %5d,  Chunk points: %9ld,  Total points: %12ld,  %s\n",
-				chunkCount, numChunks, abcdDistribution->GetNumPoints(), pointCount, timebuff);
-		printf("%s",buff);
-		fflush(stdout);
-		
-		if (directory != "/dev/null") {
-			char filename[1024];
-			sprintf(filename, "%schunk%06d.txt", directory.c_str(), chunkCount);
-			PrintStatusFile(buff, filename);
-		}
+		PrintChunkStatus(chunkCount, numChunks, abcdDistribution->GetNumCandidateCells(), abcdDistribution->GetNumCells(),
+						 cellCount, directory);
 		
 		delete(abcdDistribution);
 		
-		partialSpaceLimits.limits[1][0]+=increment*interval;
-		partialSpaceLimits.limits[0][1]-=increment*interval;
+		partialSpaceLimits.limits[1][0]+=interval;
+		partialSpaceLimits.limits[0][1]-=interval;
 	}
-	printf("\nTotal points in the probability distribution: %ld.\n", pointCount);
+	printf("\nTotal cells in the continuous probability distribution: %ld, %ld with nonzero probability.\n",
+		   cellCount, nonzeroCellCount);
 	
 	if (chunkCount != numChunks) {
 		printf("!!! ERROR: PRECOMPUTED CHUNK COUNT, %d, DOES NOT MATCH ACTUAL CHUNK COUNT, %d !!!\n\n", 
 			   numChunks, chunkCount);
 	}
-	if (pointCount != preCalcNumPoints) {
-		printf("!!! ERROR: PRECOMPUTED POINT COUNT, %ld, DOES NOT MATCH ACTUAL POINT COUNT, %ld !!!\n\n", 
-			   preCalcNumPoints, pointCount);
+}
+
+// bounds of blocks are compared to exact probabilities with this relative
+// margin, so that rounding cannot prune a block holding a top hotspot
+static const Double BoundTolerance = 1e-12;
+
+// Finds the topK most probable hotspots.  With an M file every hotspot is a
+// combination of the required ones, so a single pass over the chunks
+// evaluates those alone, as a full run does, and the topK are picked from
+// the regenerated probabilities.  Otherwise by branch & bound: the
+// probability of a block bounds that of each of its hotspots, so only the
+// blocks whose bounds reach the topK-th most probable hotspot found so far
+// need to be split into the blocks of the next level, down to single
+// hotspots.  Each pass over the chunks evaluates the blocks selected by the
+// previous one; a single chunk is kept between passes, which then each
+// evaluate a batch of topK hotspots to raise the bound quickly, while more
+// chunks are loaded from the likelihood cache for each pass, which then
+// evaluates every block reaching the bound.
+void PossibleHotspotsDistribution::CalculateTopProbabilities(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits,
+															   RegenerateMatrix* regenMat) {
+	if (regenMat != NULL) {
+		regenMat->MatchHotspots(possibleHotspots);
+		CalculateGridProbabilities(observedHotspots, limits, regenMat, "/dev/null");
+		regenMat->RegenerateProbabilities(possibleHotspots);
+		
+		std::vector<Block> hotspots(possibleHotspots.Size());
+		std::vector<const Block*> ranking;
+		for (long int i = 0; i < possibleHotspots.Size(); i++) {
+			hotspots[i].coord = possibleHotspots.GetCoords(i);
+			hotspots[i].prob = possibleHotspots.Prob(i);
+			ranking.push_back(&hotspots[i]);
+		}
+		Double sumProb = ReproducibleSum(PackedProbabilities(&possibleHotspots), possibleHotspots.Size());
+		KeepTopHotspots(ranking, sumProb);
+		return;
 	}
 	
-	if (!IsPartial()) {
-		if (regenMat != NULL) {
-			regenMat->RegenerateProbabilities(possibleHotspots);
+	AbcdSpaceLimitsInt abcdSpaceLimits = limits.GenerateAbcdSpaceLimitsInt(gridRes);
+	ObservationTable observations(observedHotspots, abcdSpaceLimits, gridRes);
+	
+	std::vector<AbcdSpaceLimitsInt> chunks;
+	if (memoryBudget > 0)
+		PlanChunksByMemory(abcdSpaceLimits, &chunks);
+	else
+		PlanChunksByInterval(abcdSpaceLimits, &chunks);
+	fflush(stdout);
+	
+	// computing every chunk again for each pass costs several full runs
+	if (chunks.size() > 1 && cache == NULL) {
+		printf("Error: Without an M file, the top hotspots over %d chunks need a likelihood cache, -cacheDir, or a single chunk.\n",
+			   (int)chunks.size());
+		exit(EXIT_FAILURE);
+	}
+	
+	std::vector<Block> levels[NumBlockLevels];
+	BuildBlocks(levels);
+	
+	// the bounds are cheap next to the hotspots, so the first pass
+	// evaluates those of every block above them
+	std::vector<int> requests[NumBlockLevels];
+	for (int level = 0; level < NumBlockLevels - 1; level++) {
+		for (unsigned int i = 0; i < levels[level].size(); i++) {
+			requests[level].push_back(i);
+			levels[level][i].expanded = level < NumBlockLevels - 2;
 		}
-		Normalize();
+	}
+	
+	AbcdSpaceProbabilityDistribution* keptDistribution = NULL;
+	int numPasses = 0;
+	int cacheHits = cache != NULL ? cache->GetNumHits() : 0;
+	while (!requests[0].empty() || !requests[1].empty() || !requests[2].empty()) {
+		for (std::vector<AbcdSpaceLimitsInt>::iterator chunk = chunks.begin(); chunk < chunks.end(); chunk++) {
+			AbcdSpaceProbabilityDistribution* abcdDistribution = keptDistribution;
+			if (abcdDistribution == NULL) {
+				abcdDistribution = new AbcdSpaceProbabilityDistribution(observations, *chunk, gridRes, increment, false, cache);
+				if (!requests[0].empty() || !requests[1].empty())
+					abcdDistribution->SumRows();
+			}
+			
+			EvaluateBlocks(abcdDistribution, levels, requests);
+			
+			if (chunks.size() == 1)
+				keptDistribution = abcdDistribution;
+			else
+				delete(abcdDistribution);
+		}
+		
+		for (int level = 0; level < NumBlockLevels; level++) {
+			for (std::vector<int>::iterator it = requests[level].begin(); it < requests[level].end(); it++)
+				levels[level][*it].evaluated = true;
+		}
+		numPasses++;
+		
+		SelectBlocks(levels, requests, chunks.size() == 1 ? topK : 0);
+	}
+	delete(keptDistribution);
+	
+	int numEvaluated[NumBlockLevels];
+	for (int level = 0; level < NumBlockLevels; level++) {
+		numEvaluated[level] = 0;
+		for (std::vector<Block>::iterator block = levels[level].begin(); block < levels[level].end(); block++)
+			numEvaluated[level] += block->evaluated;
+	}
+	printf("Evaluated %d of %d moon cells, %d of %d mars latitudes & %d of %d hotspots in %d passes over %d chunks.\n",
+		   numEvaluated[0], (int)levels[0].size(), numEvaluated[1], (int)levels[1].size(),
+		   numEvaluated[2], (int)levels[2].size(), numPasses, (int)chunks.size());
+	if (cache != NULL && chunks.size() > 1)
+		printf("Chunks loaded from the likelihood cache: %d of %d.\n", cache->GetNumHits() - cacheHits, numPasses*(int)chunks.size());
+	
+	// the moon cells together hold the probability of every hotspot
+	std::vector<Double> cellProbs;
+	for (std::vector<Block>::iterator block = levels[0].begin(); block < levels[0].end(); block++)
+		cellProbs.push_back(block->prob);
+	Double sumProb = ReproducibleSum(cellProbs, cellProbs.size());
+	
+	std::vector<const Block*> ranking;
+	for (std::vector<Block>::iterator block = levels[2].begin(); block < levels[2].end(); block++) {
+		if (block->evaluated)
+			ranking.push_back(&*block);
+	}
+	KeepTopHotspots(ranking, sumProb);
+}
+
+// replaces the possible hotspots with the topK most probable of the ranked ones
+void PossibleHotspotsDistribution::KeepTopHotspots(std::vector<const Block*> ranking, Double sumProb) {
+	std::sort(ranking.begin(), ranking.end(), CompareBlocks);
+	ranking.resize(std::min((int)ranking.size(), topK));
+	
+	possibleHotspots.Clear();
+	for (std::vector<const Block*>::iterator it = ranking.begin(); it < ranking.end(); it++)
+		possibleHotspots.Add((*it)->coord, (*it)->prob/sumProb);
+}
+
+bool PossibleHotspotsDistribution::CompareBlocks(const Block* a, const Block* b) {
+	if (a->prob != b->prob)
+		return a->prob > b->prob;
+	return a < b;
+}
+
+// groups the possible hotspots, which are in coordinate order, by moon cell
+// and then by mars latitude
+void PossibleHotspotsDistribution::BuildBlocks(std::vector<Block>* levels) {
+	for (long int i = 0; i < possibleHotspots.Size(); i++) {
+		HotspotCoords coord = possibleHotspots.GetCoords(i);
+		Block blocks[NumBlockLevels];
+		for (int level = 0; level < NumBlockLevels; level++) {
+			blocks[level].coord = coord;
+			blocks[level].prob = 0;
+			blocks[level].evaluated = false;
+			blocks[level].expanded = false;
+		}
+		blocks[0].coord.marsLat = HotspotCoords::MissingCoord;
+		blocks[0].coord.marsLong = HotspotCoords::MissingCoord;
+		blocks[1].coord.marsLong = HotspotCoords::MissingCoord;
+		
+		for (int level = 0; level < NumBlockLevels; level++) {
+			std::vector<Block> &blocksOfLevel = levels[level];
+			if (level == NumBlockLevels - 1 || blocksOfLevel.empty() || blocksOfLevel.back().coord != blocks[level].coord) {
+				blocks[level].firstChild = level + 1 < NumBlockLevels ? levels[level + 1].size() : 0;
+				blocks[level].lastChild = blocks[level].firstChild;
+				blocksOfLevel.push_back(blocks[level]);
+			}
+			if (level > 0)
+				levels[level - 1].back().lastChild = blocksOfLevel.size();
+		}
+	}
+}
+
+void PossibleHotspotsDistribution::EvaluateBlocks(AbcdSpaceProbabilityDistribution* abcdDistribution, std::vector<Block>* levels,
+												  const std::vector<int>* requests) {
+	for (int level = 0; level < NumBlockLevels; level++) {
+		int numRequests = requests[level].size();
+		
+		#ifdef using_parallel
+		#pragma omp parallel for schedule(dynamic)
+		#endif
+		for (int i = 0; i < numRequests; i++) {
+			Block &block = levels[level][requests[level][i]];
+			if (level == NumBlockLevels - 1)
+				block.prob = abcdDistribution->CalculateHotspotProbability(block.coord, block.prob);
+			else
+				block.prob = abcdDistribution->CalculateBlockProbability(block.coord, block.prob);
+		}
+	}
+}
+
+// selects the blocks to evaluate in the next pass: until topK hotspots are
+// evaluated, the children of the most probable blocks holding them, and
+// then those of the blocks whose bounds reach the topK-th most probable
+// hotspot, most probable first, up to batchSize hotspots if not 0
+void PossibleHotspotsDistribution::SelectBlocks(std::vector<Block>* levels, std::vector<int>* requests, int batchSize) {
+	const int hotspotLevel = NumBlockLevels - 1;
+	std::vector<const Block*> hotspots;
+	for (std::vector<Block>::iterator block = levels[hotspotLevel].begin(); block < levels[hotspotLevel].end(); block++) {
+		if (block->evaluated)
+			hotspots.push_back(&*block);
+	}
+	
+	for (int level = 0; level < NumBlockLevels; level++)
+		requests[level].clear();
+	
+	int needed = topK - (int)hotspots.size();
+	bool known = needed <= 0;
+	Double threshold = 0;
+	if (known) {
+		std::nth_element(hotspots.begin(), hotspots.begin() + topK - 1, hotspots.end(), CompareBlocks);
+		threshold = hotspots[topK - 1]->prob*(1 - BoundTolerance);
+	}
+	
+	// the deepest level first, so that splitting its blocks may already
+	// cover the hotspots needed; splitting the moon cells only evaluates
+	// more bounds, so the batch limits the deepest level alone
+	for (int level = hotspotLevel - 1; level >= 0; level--) {
+		bool limited = !known || (batchSize > 0 && level == hotspotLevel - 1);
+		int budget = known ? batchSize : needed;
+		
+		std::vector<Block*> candidates;
+		for (std::vector<Block>::iterator block = levels[level].begin(); block < levels[level].end(); block++) {
+			if (block->evaluated && !block->expanded && block->prob > 0 && block->prob >= threshold)
+				candidates.push_back(&*block);
+		}
+		std::sort(candidates.begin(), candidates.end(), CompareBlocks);
+		
+		for (std::vector<Block*>::iterator it = candidates.begin(); it < candidates.end(); it++) {
+			if (limited && budget <= 0)
+				break;
+			Block &block = **it;
+			for (int child = block.firstChild; child < block.lastChild; child++)
+				requests[level + 1].push_back(child);
+			block.expanded = true;
+			budget -= CountHotspots(levels, level, block);
+		}
+		
+		if (!known) {
+			needed = budget;
+			if (needed <= 0)
+				break;
+		}
+	}
+	
+	for (int level = 0; level < NumBlockLevels; level++)
+		std::sort(requests[level].begin(), requests[level].end());
+}
+
+int PossibleHotspotsDistribution::CountHotspots(const std::vector<Block>* levels, int level, const Block &block) {
+	int first = block.firstChild;
+	int last = block.lastChild;
+	for (int childLevel = level + 1; childLevel < NumBlockLevels - 1; childLevel++) {
+		first = levels[childLevel][first].firstChild;
+		last = levels[childLevel][last - 1].lastChild;
+	}
+	return last - first;
+}
+
+void PossibleHotspotsDistribution::PrintChunkStatus(int chunkCount, int numChunks, long int chunkPoints, long int nonzeroPoints,
+													long int totalPoints, std::string directory) {
+	time_t now = time(0);
+	struct std::tm* tstruct = localtime(&now);
+	char timebuff[512];
+	strftime(timebuff, sizeof(timebuff), "%a %F %T UTC%z", tstruct);
+	
+	char buff[1024];
+	sprintf(buff, "Chunk %5d of %5d,  Chunk points: %9ld,  Nonzero: %5.1f%%,  Total points: %12ld,  %s\n",
+			chunkCount, numChunks, chunkPoints, chunkPoints > 0 ? (100.0*nonzeroPoints)/chunkPoints : 0.0, totalPoints, timebuff);
+	printf("%s",buff);
+	fflush(stdout);
+	
+	if (directory != "/dev/null") {
+		char filename[1024];
+		sprintf(filename, "%schunk%06d.txt", directory.c_str(), chunkCount);
+		PrintStatusFile(buff, filename);
 	}
 }
 
@@ -131,18 +651,18 @@ bool PossibleHotspotsDistribution::IsPartial() {
 }
 
 void PossibleHotspotsDistribution::AdjustStartEndIndices() {
-	if (startIndex > (int)possibleHotspots.size())
-		startIndex = possibleHotspots.size();
-	if (endIndex > (int)possibleHotspots.size())
-		endIndex = possibleHotspots.size();
+	if (startIndex > (int)possibleHotspots.Size())
+		startIndex = possibleHotspots.Size();
+	if (endIndex > (int)possibleHotspots.Size())
+		endIndex = possibleHotspots.Size();
 	
-	if (startIndex == 1 && endIndex == (int)possibleHotspots.size()) {
+	if (startIndex == 1 && endIndex == (int)possibleHotspots.Size()) {
 		startIndex = 0;
 		endIndex = 0;
 	}
 }
 
-void PossibleHotspotsDistribution::AdjustStartEndIndices(AbcdSpaceLimits limits, int &startIndex, int &endIndex)
+void PossibleHotspotsDistribution::AdjustStartEndIndices(const AbcdSpaceLimits &limits, int &startIndex, int &endIndex)
 {
 	PossibleHotspotsDistribution possibleHotspots(startIndex, endIndex);
 	possibleHotspots.CalculatePossibleHotspotCoords(limits);
@@ -161,7 +681,7 @@ void PossibleHotspotsDistribution::ValidateIndexLimits(int startIndex, int endIn
 	exit(EXIT_FAILURE);
 }
 
-void PossibleHotspotsDistribution::CalculatePossibleHotspotCoords(AbcdSpaceLimits limits, bool nonremovable) {
+void PossibleHotspotsDistribution::CalculatePossibleHotspotCoords(const AbcdSpaceLimits &limits, bool nonremovable) {
 	Coord minLat = HotspotCoords::MinLat;
 	Coord maxLat = HotspotCoords::MaxLat;
 	Coord minLong = HotspotCoords::MinLong;
@@ -183,8 +703,7 @@ void PossibleHotspotsDistribution::CalculatePossibleHotspotCoords(AbcdSpaceLimit
 							for (Coord marsLong = minLong; marsLong <= maxLong; marsLong ++) {
 								coords.marsLong = marsLong;
 								if (limits.CheckHotspot(coords, nonremovable)) {
-									coords.prob = 0;
-									possibleHotspots.push_back(coords);
+									possibleHotspots.Add(coords);
 								}
 							}
 							coords.marsLong = HotspotCoords::MissingCoord;
@@ -197,14 +716,15 @@ void PossibleHotspotsDistribution::CalculatePossibleHotspotCoords(AbcdSpaceLimit
 		}
 	}
 	
-	printf("Found %zu possible hotspots.\n", possibleHotspots.size());
+	printf("Found %ld possible hotspots.\n", possibleHotspots.Size());
 	
 	AdjustStartEndIndices();
 }
 
-void PossibleHotspotsDistribution::AccumulateProbabilities(AbcdSpaceProbabilityDistribution* abcdDistribution, RegenerateMatrix* regenMat) {
+template <class Distribution>
+void PossibleHotspotsDistribution::AccumulateProbabilities(Distribution* abcdDistribution, RegenerateMatrix* regenMat) {
 	int start = 0;
-	int end = possibleHotspots.size() - 1;
+	int end = possibleHotspots.Size() - 1;
 	
 	if (IsPartial()) {
 		start = startIndex - 1;
@@ -216,39 +736,28 @@ void PossibleHotspotsDistribution::AccumulateProbabilities(AbcdSpaceProbabilityD
 	#endif
 	for (int i=start; i<=end; i++) {
 		if(regenMat == NULL || regenMat->IsRequired(i))
-			possibleHotspots[i].prob = abcdDistribution->CalculateHotspotProbability(possibleHotspots[i], possibleHotspots[i].prob);
+			possibleHotspots.SetProb(i, abcdDistribution->CalculateHotspotProbability(possibleHotspots.GetCoords(i), possibleHotspots.Prob(i)));
 	}
 }
 
 void PossibleHotspotsDistribution::PrintToFile(std::string filename, bool printProbs){
-	FILE* file = fopen(filename.c_str(), "w");
-	if(!file) {
-		printf("Error: Could not open file for writing: \"%s\"\n", filename.c_str());
-		exit(EXIT_FAILURE);
-	}
-	
+	std::string header;
 	if(IsPartial()) {
-		fprintf(file, "!! THIS IS A PARTIAL FILE !!\n");
-		fprintf(file, "START INDEX = %7d\n", startIndex);
-		fprintf(file, "END   INDEX = %7d\n", endIndex);
-		fprintf(file, "GRID  RES   = %7d\n", gridRes);
-		fprintf(file, "INCREMENT   = %7d\n", increment);
-		fprintf(file, "INTERVAL    = %7d\n", interval);
-		fprintf(file, "DEDUP OBS   = %7s\n\n", dedupObserved ? "TRUE" : "FALSE");
-		fprintf(file, "PROBABILITIES ARE NOT NORMALIZED\n\n");
-	}
-	
-	for(std::vector<HotspotCoordsWithProbability>::iterator it = possibleHotspots.begin(); it<possibleHotspots.end(); it++){
-		HotspotCoordsWithProbability coords = *it;
-		std::string coordStr;
-		if(printProbs)
-			coordStr = coords.ToString();
-		else
-			coordStr = ((HotspotCoords)coords).ToString();
-		fprintf(file, "%s\n", coordStr.c_str());
+		char buff[1024];
+		sprintf(buff, "!! THIS IS A PARTIAL FILE !!\n"
+				"START INDEX = %7d\n"
+				"END   INDEX = %7d\n"
+				"GRID  RES   = %7d\n"
+				"INCREMENT   = %7d\n"
+				"INTERVAL    = %7d\n"
+				"DEDUP OBS   = %7s\n\n"
+				"PROBABILITIES ARE NOT NORMALIZED\n\n",
+				startIndex, endIndex, continuous ? 0 : gridRes, increment, interval, dedupObserved ? "TRUE" : "FALSE");
+		header = buff;
 	}
 	
-	fclose(file);
+	LineFormatter formatter(&possibleHotspots, printProbs);
+	WriteFixedWidthFile(filename, header, possibleHotspots.Size(), formatter.GetLineWidth(), formatter);
 	
 	if(printProbs)
 		printf("Printed hotspots with probabilities to file: \"%s\".\n", filename.c_str());
@@ -261,64 +770,88 @@ void PossibleHotspotsDistribution::PrintToFile(std::string filename, bool printP
 	}
 }
 
-void PossibleHotspotsDistribution::Normalize() {
-	Normalize(&possibleHotspots);	
+void PossibleHotspotsDistribution::PrintRankingToFile(std::string filename) {
+	FILE* file = fopen(filename.c_str(), "w");
+	if(!file) {
+		printf("Error: Could not open file for writing: \"%s\"\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	
+	Double coverage = 0;
+	for (long int i = 0; i < possibleHotspots.Size(); i++) {
+		coverage += possibleHotspots.Prob(i);
+		fprintf(file, "%6ld%s%46.36Le\n", i + 1, possibleHotspots[i].ToString().c_str(), coverage);
+	}
+	
+	fclose(file);
+	
+	printf("Printed %d top hotspots & their cumulative probability to file: \"%s\".\n", (int)possibleHotspots.Size(), filename.c_str());
 }
 
-void PossibleHotspotsDistribution::Normalize(std::vector<HotspotCoordsWithProbability>* points) {
-	Double sumProb = 0;
-	for(std::vector<HotspotCoordsWithProbability>::iterator coord=points->begin(); coord<points->end(); coord++)
-		sumProb += coord->prob;
-	for(std::vector<HotspotCoordsWithProbability>::iterator coord=points->begin(); coord<points->end(); coord++)
-		coord->prob /= sumProb;	
+PossibleHotspotsDistribution::LineFormatter::LineFormatter(const PackedHotspots* inPoints, bool inPrintProbs) :
+	points(inPoints),
+	printProbs(inPrintProbs)
+{
+}
+
+int PossibleHotspotsDistribution::LineFormatter::GetLineWidth() const {
+	return 4*CoordWidth + (printProbs ? ProbWidth : 0) + 1;
+}
+
+void PossibleHotspotsDistribution::LineFormatter::Format(long int begin, long int end, char* buffer) const {
+	for (long int i = begin; i < end; i++) {
+		HotspotCoordsWithProbability point = (*points)[i];
+		FormatFixedWidthInteger(buffer, CoordWidth, point.moonLat);
+		FormatFixedWidthInteger(buffer + CoordWidth, CoordWidth, point.moonLong);
+		FormatFixedWidthInteger(buffer + 2*CoordWidth, CoordWidth, point.marsLat);
+		FormatFixedWidthInteger(buffer + 3*CoordWidth, CoordWidth, point.marsLong);
+		buffer += 4*CoordWidth;
+		if (printProbs) {
+			FormatFixedWidth(buffer, ProbWidth, "%46.36Le", point.prob);
+			buffer += ProbWidth;
+		}
+		*buffer++ = '\n';
+	}
 }
 
-Double PossibleHotspotsDistribution::GetTotalProbability(PossibleHotspotsDistribution points) {
-	std::vector<HotspotCoordsWithProbability> allPoints = possibleHotspots;
-	std::vector<HotspotCoordsWithProbability> selectedPoints = points.possibleHotspots;
+void PossibleHotspotsDistribution::Normalize() {
+	long int numPoints = possibleHotspots.Size();
+	Double sumProb = ReproducibleSum(PackedProbabilities(&possibleHotspots), numPoints);
 	
-	std::sort(allPoints.begin(), allPoints.end(), HotspotCoords::Compare);
-	std::sort(selectedPoints.begin(), selectedPoints.end(), HotspotCoords::Compare);
+	#ifdef using_parallel
+	#pragma omp parallel for
+	#endif
+	for(long int i=0; i<numPoints; i++)
+		possibleHotspots.SetProb(i, possibleHotspots.Prob(i)/sumProb);
+}
+
+void PossibleHotspotsDistribution::Normalize(std::vector<HotspotCoordsWithProbability>* points) {
+	long int numPoints = points->size();
+	Double sumProb = ReproducibleSum(HotspotProbabilities(points), numPoints);
 	
-	std::vector<HotspotCoordsWithProbability>::iterator itAll = allPoints.begin();
-	std::vector<HotspotCoordsWithProbability>::iterator itSel = selectedPoints.begin();
+	#ifdef using_parallel
+	#pragma omp parallel for
+	#endif
+	for(long int i=0; i<numPoints; i++)
+		(*points)[i].prob /= sumProb;
+}
+
+const PackedHotspots& PossibleHotspotsDistribution::GetHotspots() const {
+	return possibleHotspots;
+}
+
+Double PossibleHotspotsDistribution::GetTotalProbability(const PossibleHotspotsDistribution &points) {
+	const PackedHotspots &selectedPoints = points.possibleHotspots;
 	
-	int matchedPoints = 0;
-	Double totalProb = 0;
-	while (true) {
-		if(itSel == selectedPoints.end()) {
-			break;
-		}
-		
-		if(itAll == allPoints.end()) {
-			printf("Error: Reached end of point list with selected points remaining.\n");
-			printf("Next selected point is: %s.\n", ((HotspotCoords)(*itSel)).ToString().c_str());
+	std::vector<Double> matchedProbs(selectedPoints.Size());
+	for (long int i = 0; i < selectedPoints.Size(); i++) {
+		int position = possibleHotspots.Find(selectedPoints.GetCoords(i));
+		if (position < 0) {
+			printf("Error: Could not match selected point: %s.\n", selectedPoints.GetCoords(i).ToString().c_str());
 			exit(EXIT_FAILURE);
 		}
-		
-		// *itAll < *itSel
-		if(HotspotCoords::Compare(*itAll, *itSel)) {
-			itAll++;
-			continue;
-		}
-		   
-		// *itAll > *itSel
-		if(HotspotCoords::Compare(*itSel, *itAll)) {
-			printf("Error: Could not match selected point: %s.\n", ((HotspotCoords)(*itSel)).ToString().c_str());
-			exit(EXIT_FAILURE);
-		}
-		
-		// points are equal
-		totalProb += itAll->prob;
-		matchedPoints++;
-		itAll++;
-		itSel++;
-	}
-	if (matchedPoints != (int)selectedPoints.size()) {
-		printf("Error: Matched point count, %d, does not match total number of selected points, %zu.\n", 
-			   matchedPoints, selectedPoints.size());
-		exit(EXIT_FAILURE);
+		matchedProbs[i] = possibleHotspots.Prob(position);
 	}
 	
-	return totalProb;
+	return ReproducibleSum(matchedProbs, matchedProbs.size());
 }
@@ -6,43 +6,106 @@
 #include <vector>
 #include "AbcdSpaceLimits.h"
 #include "AbcdSpaceProbabilityDistribution.h"
+#include "AbcdSpaceContinuousDistribution.h"
 #include "HotspotCoordsWithProbability.h"
 #include "RegenerateMatrix.h"
+#include "PackedHotspots.h"
 
 class PossibleHotspotsDistribution {
 public:
+	// packs the points, & frees the memory of the vector
 	PossibleHotspotsDistribution(std::vector<HotspotCoordsWithProbability>* points);
-	PossibleHotspotsDistribution(AbcdSpaceLimits limits, bool nonremovable);
-	PossibleHotspotsDistribution(ObservedHotspots observedHotspots, AbcdSpaceLimits limits, RegenerateMatrix* regenMat,
-								 int gridRes, int increment, int interval, bool dedupObserved, std::string directory="/dev/null", int startIndex=0, int endIndex=0);
+	PossibleHotspotsDistribution(const AbcdSpaceLimits &limits, bool nonremovable);
+	PossibleHotspotsDistribution(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, RegenerateMatrix* regenMat,
+								 LikelihoodCache* cache, int gridRes, int increment, int interval, int memoryBudget, bool dedupObserved, bool continuous, int cellOrder,
+								 std::string directory="/dev/null", int startIndex=0, int endIndex=0);
+	PossibleHotspotsDistribution(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, RegenerateMatrix* regenMat,
+								 LikelihoodCache* cache, int gridRes, int increment, int interval, int memoryBudget, int topK);
 	
 	void PrintToFile(std::string filename, bool printProbs = true);
-	Double GetTotalProbability(PossibleHotspotsDistribution points);
+	void PrintRankingToFile(std::string filename);
+	Double GetTotalProbability(const PossibleHotspotsDistribution &points);
+	const PackedHotspots& GetHotspots() const;
 	
 	static void ValidateIndexLimits(int startIndex, int endIndex);
-	static void AdjustStartEndIndices(AbcdSpaceLimits limits, int &startIndex, int &endIndex);
+	static void AdjustStartEndIndices(const AbcdSpaceLimits &limits, int &startIndex, int &endIndex);
 	static bool IsPartial(int startIndex, int endIndex);
 	static void Normalize(std::vector<HotspotCoordsWithProbability>* points);
+	static void PlanChunks(const AbcdSpaceLimitsInt &abcdSpaceLimits, int gridRes, int increment, int interval, int memoryBudget,
+						   std::vector<AbcdSpaceLimitsInt>* chunks);
 		
 private:
 	PossibleHotspotsDistribution(int startIndex, int endIndex); 
 
-	void CalculatePossibleHotspotCoords(AbcdSpaceLimits limits, bool nonremovable = false);
-	void AccumulateProbabilities(AbcdSpaceProbabilityDistribution* abcdDistribution, RegenerateMatrix* regenMat);
+	void CalculatePossibleHotspotCoords(const AbcdSpaceLimits &limits, bool nonremovable = false);
+	void CalculateGridProbabilities(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, RegenerateMatrix* regenMat,
+									std::string directory);
+	void CalculateContinuousProbabilities(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, RegenerateMatrix* regenMat,
+										  std::string directory);
+	void PlanChunksByInterval(const AbcdSpaceLimitsInt &abcdSpaceLimits, std::vector<AbcdSpaceLimitsInt>* chunks);
+	void PlanChunksByMemory(const AbcdSpaceLimitsInt &abcdSpaceLimits, std::vector<AbcdSpaceLimitsInt>* chunks);
+	void SliceLimits(AbcdSpaceLimitsInt* limits, int index, int first, int last);
+	static void BalanceChunks(const std::vector<long int> &sizes, long int budget, std::vector<int>* starts);
+	static int GreedyChunks(const std::vector<long int> &sizes, long int cap, std::vector<int>* starts);
+	template <class Distribution> void AccumulateProbabilities(Distribution* abcdDistribution, RegenerateMatrix* regenMat);
+	
+	// a moon cell, a moon cell & mars latitude, or a single hotspot, whose
+	// children are the blocks [firstChild, lastChild) of the next level
+	struct Block {
+		HotspotCoords coord;
+		int firstChild;
+		int lastChild;
+		Double prob;
+		bool evaluated;
+		bool expanded;
+	};
+	
+	static const int NumBlockLevels = 3;
+	
+	static bool CompareBlocks(const Block* a, const Block* b);
+	void CalculateTopProbabilities(const ObservedHotspots &observedHotspots, const AbcdSpaceLimits &limits, RegenerateMatrix* regenMat);
+	void KeepTopHotspots(std::vector<const Block*> ranking, Double sumProb);
+	void BuildBlocks(std::vector<Block>* levels);
+	void EvaluateBlocks(AbcdSpaceProbabilityDistribution* abcdDistribution, std::vector<Block>* levels, const std::vector<int>* requests);
+	void SelectBlocks(std::vector<Block>* levels, std::vector<int>* requests, int batchSize);
+	int CountHotspots(const std::vector<Block>* levels, int level, const Block &block);
 	void Normalize();
 	
+	// formats the lines of PrintToFile for WriteFixedWidthFile
+	class LineFormatter {
+	public:
+		LineFormatter(const PackedHotspots* points, bool printProbs);
+		
+		int GetLineWidth() const;
+		void Format(long int begin, long int end, char* buffer) const;
+		
+		static const int CoordWidth = 6;
+		static const int ProbWidth = 46;
+		
+	private:
+		const PackedHotspots* points;
+		bool printProbs;
+	};
+	
+	void PrintChunkStatus(int chunkCount, int numChunks, long int chunkPoints, long int nonzeroPoints, long int totalPoints,
+						  std::string directory);
 	void PrintStatusFile(char* buff, char* filename);
 	
 	void AdjustStartEndIndices();
 	bool IsPartial();
 	
-	std::vector <HotspotCoordsWithProbability> possibleHotspots;
+	PackedHotspots possibleHotspots;
 	int startIndex;
 	int endIndex;
 	int gridRes;
 	int increment;
 	int interval;
+	int memoryBudget;
 	bool dedupObserved;
+	bool continuous;
+	int cellOrder;
+	int topK;
+	LikelihoodCache* cache;
 };
 
 
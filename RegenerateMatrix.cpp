@@ -1,8 +1,10 @@
 #include <cstdio>
 #include <cstdlib>
 #include "RegenerateMatrix.h"
+#include "HotspotIndex.h"
 
-RegenerateMatrix::RegenerateMatrix(std::string filename)
+RegenerateMatrix::RegenerateMatrix(std::string filename) :
+	matched(false)
 {	
 	FILE* file = fopen(filename.c_str(), "r");
 	if(!file) {
@@ -79,37 +81,98 @@ bool RegenerateMatrix::IsRequired(int index)
 	return requiredIndices.find(index) != requiredIndices.end();
 }
 
-void RegenerateMatrix::RegenerateProbabilities(std::vector<HotspotCoordsWithProbability> &hotspotsIn)
+void RegenerateMatrix::MatchHotspots(const std::vector<HotspotCoordsWithProbability> &hotspotsIn)
+{
+	if (!matched)
+		MatchPositions(HotspotIndex(hotspotsIn), hotspotsIn.size());
+}
+
+void RegenerateMatrix::MatchHotspots(const PackedHotspots &hotspotsIn)
 {
-	if (numPoints != (int)hotspotsIn.size()) {
-		printf("Error: Possible hotspot count from matrix, %d, does not match computed possible hotspot count, %zu.\n",
-			   numPoints, hotspotsIn.size());
+	if (!matched && hotspotsIn.IsSorted())
+		MatchPositions(hotspotsIn, hotspotsIn.Size());
+	else if (!matched)
+		MatchPositions(HotspotIndex(hotspotsIn.ToVector()), hotspotsIn.Size());
+}
+
+template <class Index>
+void RegenerateMatrix::MatchPositions(const Index &index, int numIn)
+{
+	if (numPoints != numIn) {
+		printf("Error: Possible hotspot count from matrix, %d, does not match computed possible hotspot count, %d.\n",
+			   numPoints, numIn);
 		exit(EXIT_FAILURE);
 	}
 	
+	// translate the indices of the M file into positions in the hotspots
+	std::vector<int> positions(numPoints);
 	for (int i=0; i<numPoints; i++) {
-		if (possibleHotspots[i] != hotspotsIn[i]) {
-			printf("Error: Coordinate %d from M file do not match calculated coordinates:\n",
-				i+1);
-			printf("From M file: %s.\n", possibleHotspots[i].ToString().c_str());
-			printf("Calculated : %s.\n",  ((HotspotCoords)hotspotsIn[i]).ToString().c_str());
+		positions[i] = index.Find(possibleHotspots[i]);
+		if (positions[i] < 0) {
+			printf("Error: Coordinate %d from M file is not a calculated possible hotspot: %s.\n",
+				i+1, possibleHotspots[i].ToString().c_str());
 			exit(EXIT_FAILURE);
 		}
 	}
 	
+	for (std::vector<MatElem>::iterator matElem = matrix.begin(); matElem<matrix.end(); matElem++) {
+		matElem->toInd = positions[matElem->toInd];
+		matElem->fromInd = positions[matElem->fromInd];
+	}
+	
+	std::set<int> requiredPositions;
+	for (std::set<int>::iterator it = requiredIndices.begin(); it != requiredIndices.end(); it++)
+		requiredPositions.insert(positions[*it]);
+	requiredIndices = requiredPositions;
+	
+	matched = true;
+}
+
+void RegenerateMatrix::RegenerateProbabilities(std::vector<HotspotCoordsWithProbability> &hotspotsIn)
+{
+	MatchHotspots(hotspotsIn);
+	
+	std::vector<Double> probs(hotspotsIn.size());
+	for (unsigned int i = 0; i < hotspotsIn.size(); i++)
+		probs[i] = hotspotsIn[i].prob;
+	RegenerateProbabilities(&probs);
+	for (unsigned int i = 0; i < hotspotsIn.size(); i++)
+		hotspotsIn[i].prob = probs[i];
+}
+
+void RegenerateMatrix::RegenerateProbabilities(PackedHotspots &hotspotsIn)
+{
+	MatchHotspots(hotspotsIn);
 	printf("Regenerating all %d points from %zu calculated points.\n", numPoints,requiredIndices.size());
 	
-	std::vector<Double> savedProbs;
-	for (std::vector<HotspotCoordsWithProbability>::iterator hotspot = hotspotsIn.begin(); hotspot<hotspotsIn.end(); hotspot++) {
-		savedProbs.push_back(hotspot->prob);
-		hotspot->prob = 0;
+	// added to in place, so that only one unpacked copy is held
+	std::vector<Double> savedProbs(hotspotsIn.Size());
+	for (long int i = 0; i < hotspotsIn.Size(); i++) {
+		savedProbs[i] = hotspotsIn.Prob(i);
+		hotspotsIn.SetProb(i, 0);
+	}
+	
+	for (std::vector<MatElem>::iterator matElem = matrix.begin(); matElem<matrix.end(); matElem++) {
+		int toInd = matElem->toInd;
+		int fromInd = matElem->fromInd;
+		int multiplier = matElem->multiplier;
+		
+		hotspotsIn.SetProb(toInd, hotspotsIn.Prob(toInd) + multiplier*savedProbs[fromInd]);
 	}
+}
+
+void RegenerateMatrix::RegenerateProbabilities(std::vector<Double>* probs)
+{
+	printf("Regenerating all %d points from %zu calculated points.\n", numPoints,requiredIndices.size());
+	
+	std::vector<Double> savedProbs(probs->size());
+	savedProbs.swap(*probs);
 	
 	for (std::vector<MatElem>::iterator matElem = matrix.begin(); matElem<matrix.end(); matElem++) {
 		int toInd = matElem->toInd;
 		int fromInd = matElem->fromInd;
 		int multiplier = matElem->multiplier;
 		
-		hotspotsIn[toInd].prob += multiplier*savedProbs[fromInd];
+		(*probs)[toInd] += multiplier*savedProbs[fromInd];
 	}
-}
\ No newline at end of file
+}
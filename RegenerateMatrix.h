@@ -7,15 +7,22 @@
 #include <set>
 #include "HotspotCoords.h"
 #include "HotspotCoordsWithProbability.h"
+#include "PackedHotspots.h"
 
 class RegenerateMatrix {
 public:
 	RegenerateMatrix(std::string filename);
 	
 	bool IsRequired(int index);
+	void MatchHotspots(const std::vector<HotspotCoordsWithProbability> &hotspotsIn);
+	void MatchHotspots(const PackedHotspots &hotspotsIn);
 	void RegenerateProbabilities(std::vector<HotspotCoordsWithProbability> &hotspotsIn);
+	void RegenerateProbabilities(PackedHotspots &hotspotsIn);
 	
 private:
+	template <class Index> void MatchPositions(const Index &index, int numIn);
+	void RegenerateProbabilities(std::vector<Double>* probs);
+	
 	struct MatElem {
 		int toInd;
 		int fromInd;
@@ -26,6 +33,7 @@ private:
 	std::vector<HotspotCoords> possibleHotspots;
 	std::set<int> requiredIndices;
 	int numPoints;
+	bool matched;
 };
 
 
@@ -0,0 +1,43 @@
+#ifndef __REPRODUCIBLE_SUM__
+#define __REPRODUCIBLE_SUM__
+
+
+#include <algorithm>
+#include <vector>
+#include "Common.h"
+
+static const long int SumBlockSize = 4096;
+
+// Sums terms[0] ... terms[numTerms-1] in a tree whose shape depends only on
+// numTerms: each block of SumBlockSize terms is added left to right, the
+// blocks are summed in parallel, and the block sums are then combined
+// pairwise.  The result is the same bit for bit for any number of threads.
+template <class Terms>
+Double ReproducibleSum(const Terms &terms, long int numTerms) {
+	long int numBlocks = (numTerms + SumBlockSize - 1)/SumBlockSize;
+	if (numBlocks == 0)
+		return 0;
+
+	std::vector<Double> sums(numBlocks);
+
+	#ifdef using_parallel
+	#pragma omp parallel for schedule(static)
+	#endif
+	for (long int block = 0; block < numBlocks; block++) {
+		long int end = std::min((block + 1)*SumBlockSize, numTerms);
+		Double sum = 0;
+		for (long int i = block*SumBlockSize; i < end; i++)
+			sum += terms[i];
+		sums[block] = sum;
+	}
+
+	for (long int width = 1; width < numBlocks; width *= 2) {
+		for (long int i = 0; i + width < numBlocks; i += 2*width)
+			sums[i] += sums[i + width];
+	}
+
+	return sums[0];
+}
+
+
+#endif
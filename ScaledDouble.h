@@ -0,0 +1,41 @@
+#ifndef __SCALED_DOUBLE__
+#define __SCALED_DOUBLE__
+
+
+#include <cmath>
+
+// A double mantissa with a separate binary exponent, so long products of
+// small factors can be formed in double arithmetic without underflowing.
+// The mantissa is renormalized only once it drifts far from 1.
+class ScaledDouble {
+public:
+	ScaledDouble() : mantissa(0), exponent(0) {}
+	ScaledDouble(double value) : mantissa(value), exponent(0) {}
+
+	ScaledDouble& operator*=(double factor) {
+		mantissa *= factor;
+		if (mantissa < 1e-100 || mantissa > 1e100) {
+			int shift;
+			mantissa = frexp(mantissa, &shift);
+			exponent += shift;
+		}
+		return *this;
+	}
+
+	bool operator==(double value) const {
+		if (value == 0)
+			return mantissa == 0;
+		return (long double)*this == value;
+	}
+
+	operator long double() const {
+		return ldexpl(mantissa, exponent);
+	}
+
+private:
+	double mantissa;
+	int exponent;
+};
+
+
+#endif
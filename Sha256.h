@@ -0,0 +1,29 @@
+#ifndef __SHA256__
+#define __SHA256__
+
+
+#include <string>
+#include <stdint.h>
+
+// The SHA-256 digest of a stream of bytes, fed in any number of pieces.
+class Sha256 {
+public:
+	Sha256();
+
+	void Update(const void* data, size_t length);
+	// the digest as 64 lowercase hex digits; no more data may be added
+	std::string Final();
+
+	static std::string DigestFile(std::string filename, long int* size = NULL);
+
+private:
+	void Transform(const unsigned char* block);
+
+	uint32_t state[8];
+	unsigned char buffer[64];
+	unsigned int bufferLength;
+	uint64_t totalLength;
+};
+
+
+#endif
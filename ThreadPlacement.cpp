@@ -0,0 +1,133 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <sched.h>
+#include <unistd.h>
+#include "ThreadPlacement.h"
+#ifdef using_parallel
+	#include <omp.h>
+#endif
+
+static const char* BindPolicies[] = {"false", "true", "master", "close", "spread", "primary"};
+static const int NumBindPolicies = 6;
+
+// each item of the comma separated list, one for each nesting level, must
+// be a policy
+static void ValidateBindPolicy(std::string bind) {
+	std::string::size_type start = 0;
+	while (start <= bind.size()) {
+		std::string::size_type end = bind.find(',', start);
+		if (end == std::string::npos)
+			end = bind.size();
+		std::string policy = bind.substr(start, end - start);
+
+		bool valid = false;
+		for (int i = 0; i < NumBindPolicies; i++)
+			valid = valid || policy == BindPolicies[i];
+		if (!valid) {
+			printf("Error: Invalid thread binding policy \"%s\".\n", bind.c_str());
+			exit(EXIT_FAILURE);
+		}
+		start = end + 1;
+	}
+}
+
+#ifdef using_parallel
+// true if the variable had to be changed
+static bool SetEnvironment(const char* name, std::string value) {
+	if (value == "")
+		return false;
+	const char* current = getenv(name);
+	if (current != NULL && value == current)
+		return false;
+
+	if (setenv(name, value.c_str(), 1) != 0) {
+		printf("Error: Could not set %s.\n", name);
+		exit(EXIT_FAILURE);
+	}
+	return true;
+}
+#endif
+
+void ConfigureThreads(int numThreads, std::string places, std::string bind, char* argv[]) {
+	if (bind != "")
+		ValidateBindPolicy(bind);
+
+#ifdef using_parallel
+	bool changedPlaces = SetEnvironment("OMP_PLACES", places);
+	bool changedBind = SetEnvironment("OMP_PROC_BIND", bind);
+	if (changedPlaces || changedBind) {
+		fflush(stdout);
+		execv("/proc/self/exe", argv);
+		printf("Error: Could not restart the program with OMP_PLACES & OMP_PROC_BIND set.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (numThreads > 0)
+		omp_set_num_threads(numThreads);
+#else
+	if (numThreads > 1 || places != "" || bind != "")
+		printf("Warning: Built without OpenMP, so the thread options are ignored.\n\n");
+#endif
+}
+
+void PrintThreadPlacement() {
+#ifdef using_parallel
+	static const char* bindNames[] = {"false", "true", "master", "close", "spread"};
+	int bind = omp_get_proc_bind();
+
+	printf("Thread binding policy:          %s\n", bind >= 0 && bind < 5 ? bindNames[bind] : "unknown");
+	printf("Number of thread places:        %4d\n", omp_get_num_places());
+#endif
+	printf("Number of sockets:              %4d\n", GetNumSockets());
+}
+
+// the socket of each cpu, those without a topology in sysfs on socket 0
+static std::vector<int> ReadCpuSockets() {
+	std::vector<int> cpuSockets;
+	std::map<int, int> packageSockets;
+	long int numCpus = sysconf(_SC_NPROCESSORS_CONF);
+	for (long int cpu = 0; cpu < numCpus; cpu++) {
+		char filename[128];
+		sprintf(filename, "/sys/devices/system/cpu/cpu%ld/topology/physical_package_id", cpu);
+		FILE* file = fopen(filename, "r");
+		int package = 0;
+		if (file != NULL) {
+			if (fscanf(file, "%d", &package) != 1)
+				package = 0;
+			fclose(file);
+		}
+
+		if (packageSockets.find(package) == packageSockets.end()) {
+			int socket = packageSockets.size();
+			packageSockets[package] = socket;
+		}
+		cpuSockets.push_back(packageSockets[package]);
+	}
+	return cpuSockets;
+}
+
+// read once, by whichever thread asks first
+static const std::vector<int> &GetCpuSockets() {
+	static const std::vector<int> cpuSockets = ReadCpuSockets();
+	return cpuSockets;
+}
+
+int GetNumSockets() {
+	const std::vector<int> &cpuSockets = GetCpuSockets();
+	int numSockets = 1;
+	for (unsigned int i = 0; i < cpuSockets.size(); i++)
+		numSockets = std::max(numSockets, cpuSockets[i] + 1);
+	return numSockets;
+}
+
+int GetCurrentSocket() {
+	const std::vector<int> &cpuSockets = GetCpuSockets();
+	int cpu = sched_getcpu();
+	if (cpu < 0 || cpu >= (int)cpuSockets.size())
+		return 0;
+	return cpuSockets[cpu];
+}
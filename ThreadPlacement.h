@@ -0,0 +1,34 @@
+#ifndef __THREAD_PLACEMENT__
+#define __THREAD_PLACEMENT__
+
+
+#include <string>
+
+// The number & placement of the OpenMP threads, & the placement of the
+// memory they use.  Linux places a page on the NUMA node of the thread
+// that first writes it, so an array filled by a single thread lands on a
+// single socket, & the threads of the other sockets read it remotely.
+
+// sets the number of threads, if positive, & the OMP_PLACES & OMP_PROC_BIND
+// the runtime reads when it starts; as it has started before main, the
+// program is executed again with them unless they are already set
+void ConfigureThreads(int numThreads, std::string places, std::string bind, char* argv[]);
+void PrintThreadPlacement();
+
+// the sockets of the cpus numbered from 0, from the topology in sysfs
+int GetNumSockets();
+int GetCurrentSocket();
+
+// zeroes the array with the static schedule of the threads, so that its
+// pages are spread over their sockets before it is filled
+template <class T>
+void FirstTouch(T* array, long int count) {
+	#ifdef using_parallel
+	#pragma omp parallel for schedule(static)
+	#endif
+	for (long int i = 0; i < count; i++)
+		array[i] = 0;
+}
+
+
+#endif
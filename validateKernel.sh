@@ -0,0 +1,41 @@
+#!/bin/bash
+
+# Runs CNmoonmars with the long double likelihood kernel and with the default
+# double kernel, then reports how far the possible hotspot probabilities of
+# the fast kernel deviate from the long double ones.
+# Any arguments are passed to both CNmoonmars runs, e.g. -gridRes 5.
+
+CMDSTR="$@"
+
+REFDIR=output/validate-kernel/longdouble/
+TESTDIR=output/validate-kernel/double/
+mkdir -p $REFDIR $TESTDIR
+
+echo +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+echo Building with the long double kernel:
+make clean
+make LONG_DOUBLE_KERNEL=true || exit 1
+
+RUNSTR="./CNmoonmars $CMDSTR -outputDir $REFDIR"
+echo Running \"$RUNSTR\":
+time $RUNSTR > $REFDIR/console-output.txt || exit 1
+
+echo +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+echo Building with the double kernel:
+make clean
+make || exit 1
+
+RUNSTR="./CNmoonmars $CMDSTR -outputDir $TESTDIR"
+echo Running \"$RUNSTR\":
+time $RUNSTR > $TESTDIR/console-output.txt || exit 1
+
+echo +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+./CNmoonmarsCompare $REFDIR/possiblehotspots.txt $TESTDIR/possiblehotspots.txt
+echo
+echo Nonremovable probability with the long double kernel:
+cat $REFDIR/nonremovable-prob.txt
+echo Nonremovable probability with the double kernel:
+cat $TESTDIR/nonremovable-prob.txt